@@ -13,4 +13,16 @@
 
 // Use default MCR_EXPORT and MCR_IMPORT, detecting GCC or Clang.
 
-
+/*! Default { key code, @ref mcr_ModFlags } pairs, tracked by
+ *  @ref mcr::IDispatcher::modifier.  Key codes are kVK_ virtual key
+ *  codes from Carbon Events.h. */
+#define MCR_KEY_MODIFIER_DEFAULTS                                        \
+	{ 0x37, MCR_CMD }, /* kVK_Command */                             \
+	{ 0x36, MCR_CMD }, /* kVK_RightCommand */                        \
+	{ 0x38, MCR_SHIFT }, /* kVK_Shift */                             \
+	{ 0x3C, MCR_SHIFT }, /* kVK_RightShift */                        \
+	{ 0x3A, MCR_OPTION }, /* kVK_Option */                           \
+	{ 0x3D, MCR_OPTION }, /* kVK_RightOption */                      \
+	{ 0x3B, MCR_CTRL }, /* kVK_Control */                            \
+	{ 0x3E, MCR_CTRL }, /* kVK_RightControl */                       \
+	{ 0x3F, MCR_FN } /* kVK_Function */
@@ -0,0 +1,98 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Debounce - Drop key chatter
+ */
+
+#pragma once
+
+#include "mcr/dispatcher.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mcr
+{
+/**
+ * @brief Drop key transitions that chatter.
+ *
+ *  Eager debounce: keeps the accepted state of each key code below
+ *  @ref MCR_KEY_STATE_COUNT, pressed or released, and the time it was
+ *  accepted.  A transition passes at once, and every press or release
+ *  within the window after it is dropped, so the key keeps the state it
+ *  bounced from.  After the window, a transition to the other state is
+ *  accepted, and a repeat of the accepted state passes as key repeat.  Keep
+ *  the window shorter than the fastest tap, a release within it is
+ *  dropped too.  One read, one compare and one write per key.
+ *  @ref MCR_BOTH and @ref MCR_TOGGLE, other signals and key codes pass.
+ *
+ *  Each context debounces dispatched keys before its key state and
+ *  receivers, see @ref Libmacro::debounce.  As a receiver, add it to a
+ *  dispatcher for all signals with the highest priority, and chatter
+ *  is blocked before other receivers.
+ */
+class MCR_API Debounce : public IReceive {
+    public:
+	/** @brief Construct a debounce.
+	 *  @param windowMillis Milliseconds after a transition to drop
+	 *  transitions, 0 passes all.
+	 */
+	Debounce(unsigned int windowMillis = MCR_DEBOUNCE_MILLIS) noexcept
+	{
+		setWindowMillis(windowMillis);
+	}
+	Debounce(const Debounce &) = delete;
+	virtual ~Debounce() override = default;
+	Debounce &operator=(const Debounce &) = delete;
+
+	/*! @return true if a key chatters, to block it */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override
+	{
+		(void)(mods);
+		return drop(signalPtr);
+	}
+	/** @brief Check a key transition, and remember it if accepted.
+	 *  @param signalPtr Signal, passed if not a key.
+	 *  @return true if the key chatters within the window of its last
+	 *  accepted transition.
+	 */
+	bool drop(const Signal *signalPtr) noexcept;
+
+	/*! Milliseconds after a transition to drop transitions */
+	inline unsigned int windowMillis() const noexcept
+	{
+		return static_cast<unsigned int>(
+			_windowNanos.load(std::memory_order_relaxed) / 1000000);
+	}
+	/** @brief Set milliseconds after a transition to drop transitions.
+	 *  @param millis Window, 0 passes all.
+	 */
+	inline void setWindowMillis(unsigned int millis) noexcept
+	{
+		_windowNanos.store(uint64_t(millis) * 1000000,
+				   std::memory_order_relaxed);
+	}
+	/*! Number of key transitions dropped */
+	inline size_t droppedCount() const noexcept
+	{
+		return _droppedCount.load(std::memory_order_relaxed);
+	}
+	/*! Forget all transitions, all keys are released */
+	void clear() noexcept;
+
+    private:
+	std::atomic<uint64_t> _windowNanos{0};
+	std::atomic<size_t> _droppedCount{0};
+	/*! Steady clock nanoseconds of the last accepted transition of each
+	 *  key, the lowest bit set if accepted pressed */
+	std::atomic<uint64_t> _states[MCR_KEY_STATE_COUNT] = {};
+};
+}
+
+#endif
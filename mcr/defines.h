@@ -59,6 +59,132 @@ typedef size_t mcr_id_t;
 #define MCR_MAX_PAUSE_COUNT 5
 #endif
 
+/*! Default number of signals an @ref mcr::IDispatchQueue can hold.
+ *  Rounded up to a power of 2. */
+#ifndef MCR_DISPATCH_QUEUE_SIZE
+#define MCR_DISPATCH_QUEUE_SIZE 0x100
+#endif
+
+/*! Default microseconds to wait for an @ref mcr::IDispatchQueue blocking
+ *  decision, before the signal passes through. */
+#ifndef MCR_DISPATCH_DEADLINE_MICROS
+#define MCR_DISPATCH_DEADLINE_MICROS 2000
+#endif
+
+/*! Bytes of a @ref mcr::SignalCopy.  Signals dispatched later, on another
+ *  thread, are copied into one. */
+#ifndef MCR_SIGNAL_COPY_SIZE
+#define MCR_SIGNAL_COPY_SIZE 0x80
+#endif
+
+/*! Number of recent dispatches a dispatcher records, a power of 2. */
+#ifndef MCR_DISPATCH_RECORD_COUNT
+#define MCR_DISPATCH_RECORD_COUNT 0x100
+#endif
+
+/*! Number of (signal, modifiers) dispatches a dispatcher caches, a power
+ *  of 2. */
+#ifndef MCR_DISPATCH_CACHE_SIZE
+#define MCR_DISPATCH_CACHE_SIZE 0x40
+#endif
+
+/*! Maximum receivers of one cached dispatch.  Dispatches with more
+ *  receivers are not cached. */
+#ifndef MCR_DISPATCH_CACHE_RECEIVERS
+#define MCR_DISPATCH_CACHE_RECEIVERS 8
+#endif
+
+/*! Key codes below this have an entry in a dispatcher key to modifier
+ *  table. */
+#ifndef MCR_KEY_MODIFIER_COUNT
+#define MCR_KEY_MODIFIER_COUNT 0x300
+#endif
+
+/*! Key codes below this have a pressed state in @ref mcr::KeyState. */
+#ifndef MCR_KEY_STATE_COUNT
+#define MCR_KEY_STATE_COUNT 0x300
+#endif
+
+/*! Default milliseconds between the first and last key pressed of a
+ *  @ref mcr::Chord. */
+#ifndef MCR_CHORD_WINDOW_MILLIS
+#define MCR_CHORD_WINDOW_MILLIS 50
+#endif
+
+/*! Default milliseconds between the first and last key pressed of a
+ *  @ref mcr::Sequence. */
+#ifndef MCR_SEQUENCE_TIMEOUT_MILLIS
+#define MCR_SEQUENCE_TIMEOUT_MILLIS 1000
+#endif
+
+/*! Sequences a @ref mcr::SequenceAutomaton triggers from one key without
+ *  allocating. */
+#ifndef MCR_SEQUENCE_MATCH_COUNT
+#define MCR_SEQUENCE_MATCH_COUNT 16
+#endif
+
+/*! Default milliseconds a @ref mcr::TapHold key is pressed before it
+ *  resolves to hold. */
+#ifndef MCR_TAP_HOLD_MILLIS
+#define MCR_TAP_HOLD_MILLIS 200
+#endif
+
+/*! Default milliseconds a @ref mcr::Debounce drops transitions of a key
+ *  after its last transition.  Contexts do not debounce until set. */
+#ifndef MCR_DEBOUNCE_MILLIS
+#define MCR_DEBOUNCE_MILLIS 5
+#endif
+
+/*! Default events per second triggered by a @ref mcr::Throttle. */
+#ifndef MCR_THROTTLE_RATE
+#define MCR_THROTTLE_RATE 20
+#endif
+
+/*! Default events a @ref mcr::Throttle accepts at once after idling. */
+#ifndef MCR_THROTTLE_BURST
+#define MCR_THROTTLE_BURST 1
+#endif
+
+/*! Default milliseconds from one tap to the next of a
+ *  @ref mcr::MultiTap. */
+#ifndef MCR_MULTI_TAP_MILLIS
+#define MCR_MULTI_TAP_MILLIS 300
+#endif
+
+/*! Default motion distance of one step of a @ref mcr::GestureRecognizer.
+ */
+#ifndef MCR_GESTURE_STEP
+#define MCR_GESTURE_STEP 16
+#endif
+
+/*! Default steps in one direction that make a gesture stroke. */
+#ifndef MCR_GESTURE_STROKE_STEPS
+#define MCR_GESTURE_STROKE_STEPS 2
+#endif
+
+/*! Default milliseconds without motion before a gesture starts again. */
+#ifndef MCR_GESTURE_IDLE_MILLIS
+#define MCR_GESTURE_IDLE_MILLIS 200
+#endif
+
+/*! Gestures a @ref mcr::GestureRecognizer triggers from one stroke
+ *  without allocating. */
+#ifndef MCR_GESTURE_MATCH_COUNT
+#define MCR_GESTURE_MATCH_COUNT 16
+#endif
+
+/*! Default maximum nesting of signals dispatched from inside dispatch on
+ *  one thread. */
+#ifndef MCR_DISPATCH_DEPTH_MAX
+#define MCR_DISPATCH_DEPTH_MAX 0x10
+#endif
+
+/*! Maximum signals waiting to be dispatched from inside dispatch on one
+ *  thread. */
+#ifndef MCR_DISPATCH_WORK_MAX
+#define MCR_DISPATCH_WORK_MAX 0x100
+#endif
+
 // --- 3. Platform Definition Block ---
 
 #ifndef MCR_EXPORT
@@ -91,6 +217,12 @@ typedef size_t mcr_id_t;
 
 #include MCR_PLATFORM_DEFINES_H
 
+/*! Default { key code, @ref mcr_ModFlags } pairs, defined by the platform
+ *  definitions if the platform has modifier keys. */
+#ifndef MCR_KEY_MODIFIER_DEFAULTS
+#define MCR_KEY_MODIFIER_DEFAULTS
+#endif
+
 // Compiler-specific macro definitions for symbol visibility
 #if !defined(MCR_EXPORT) && !defined(MCR_IMPORT)
 /*! Microsoft Visual Studio uses __declspec, while GCC/Clang use attributes. */
@@ -0,0 +1,115 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref IDispatchQueue - Dispatch on a worker thread, with a deadline
+ *  for the blocking decision.  @ref IShardedDispatcher - One dispatch queue
+ *  per signal source.
+ */
+
+#pragma once
+
+#include "mcr/dispatcher.h"
+
+#ifdef __cplusplus
+
+namespace mcr
+{
+/**
+ * @brief Dispatcher that hands signals to a dedicated dispatch thread.
+ *
+ *  Producers calling @ref dispatch push a copy of the signal, see
+ *  @ref Signal::copy, into a bounded lock-free queue.  The dispatch thread
+ *  dispatches the copy to the target dispatcher.  The producer sleeps until
+ *  the blocking decision or the deadline, after which the signal passes
+ *  through unblocked and receivers still receive it later.  If the queue is
+ *  full, or the signal cannot be copied, the signal is dispatched on the
+ *  calling thread.
+ *
+ *  Receivers are added to and removed from the target dispatcher.
+ *  Receivers on the dispatch thread receive the copy, not the dispatched
+ *  signal.
+ */
+class MCR_API IDispatchQueue : public IDispatcher {
+    public:
+	MCR_DECL_INTERFACE(IDispatchQueue)
+
+	/** @brief Dispatcher that receives on the dispatch thread.
+	 *  @return Target dispatcher, not owned.
+	 */
+	virtual IDispatcher *target() const noexcept = 0;
+	/** @brief Microseconds a producer waits for the blocking decision.
+	 *  @return Deadline, 0 never waits and never blocks.
+	 */
+	virtual unsigned int deadline() const noexcept = 0;
+	/** @brief Set microseconds a producer waits for the blocking
+	 *  decision.
+	 *  @param micros Deadline, 0 never waits and never blocks.
+	 */
+	virtual void setDeadline(unsigned int micros) noexcept = 0;
+	/** @brief Maximum number of signals waiting to be dispatched.
+	 *  @return Queue capacity.
+	 */
+	virtual size_t capacity() const noexcept = 0;
+	/** @brief Number of signals that passed through after the
+	 *  deadline.
+	 *  @return Expired dispatch count.
+	 */
+	virtual size_t expiredCount() const noexcept = 0;
+	/** @brief Number of signals dispatched on the calling thread
+	 *  because the queue was full, or the signal could not be copied.
+	 *  @return Overflow dispatch count.
+	 */
+	virtual size_t overflowCount() const noexcept = 0;
+};
+
+/**
+ * @brief Dispatcher that routes each signal source to its own dispatch
+ * queue.
+ *
+ *  Signals are routed by @ref Signal::source, so signals of one device
+ *  are dispatched in order on one shard thread.  Every shard dispatches to
+ *  the same target, and receivers are added to and removed from the target.
+ *
+ *  Shards only dispatch in parallel if they are not waited for.  A
+ *  producer waits for the blocking decision of its shard, see
+ *  @ref IDispatchQueue, so one intercept thread with a deadline dispatches
+ *  one signal at a time.  Devices dispatch in parallel with a deadline of
+ *  0, which never blocks, or with one producer thread per device.
+ *
+ *  Receivers of the target receive from every shard thread concurrently,
+ *  and must be thread-safe.  Signals of different sources are received in
+ *  no particular order.
+ */
+class MCR_API IShardedDispatcher : public IDispatcher {
+    public:
+	MCR_DECL_INTERFACE(IShardedDispatcher)
+
+	/** @brief Dispatcher that receives on the shard threads.
+	 *  @return Target dispatcher, not owned.
+	 */
+	virtual IDispatcher *target() const noexcept = 0;
+	/** @brief Number of shard threads.
+	 *  @return Shard count.
+	 */
+	virtual size_t shardCount() const noexcept = 0;
+	/** @brief Dispatch queue of one shard.
+	 *  @param index Shard index, less than @ref shardCount.
+	 *  @return Shard dispatch queue.
+	 *  @throws Error(ERANGE) if index is out of range.
+	 */
+	virtual IDispatchQueue &shard(size_t index) const = 0;
+	/** @brief Shard that dispatches a signal.
+	 *  @param signalPtr Signal to route.
+	 *  @return Shard index of the signal source.
+	 */
+	virtual size_t shardOf(const Signal *signalPtr) const noexcept = 0;
+	/** @brief Set the deadline of every shard.
+	 *  @param micros Deadline, 0 never waits and never blocks.
+	 */
+	virtual void setDeadline(unsigned int micros) noexcept = 0;
+};
+}
+
+#endif
@@ -15,10 +15,73 @@
 
 #ifdef __cplusplus
 
+#include <cstdint>
+
 namespace mcr
 {
 class Signal;
 class Libmacro;
+class IReceive;
+
+/**
+ * @brief One dispatch recorded by a dispatcher.
+ *
+ *  Dispatchers may record recent dispatches, to find wrong blocks and
+ *  latency after the fact.  See @ref IDispatcher::setRecordFlag and
+ *  @ref IDispatcher::snapshot.
+ */
+struct DispatchRecord {
+	/** @brief @ref Signal::name of the signal, nullptr if none. */
+	const char *signalName;
+	/** @brief @ref Signal::dispatchKey of the signal. */
+	size_t key;
+	/** @brief Active modifier flags. */
+	unsigned int mods;
+	/** @brief Receiver that blocked, nullptr if not blocked. */
+	IReceive *blockingReceiverPtr;
+	/** @brief Steady clock nanoseconds when dispatch started. */
+	uint64_t timestamp;
+	/** @brief Nanoseconds to dispatch. */
+	uint64_t duration;
+};
+
+/**
+ * @brief Time spent by one receiver, accounted by a dispatcher.
+ *
+ *  See @ref IDispatcher::setStatsFlag.
+ */
+struct ReceiverStats {
+	/** @brief Number of signals received. */
+	uint64_t callCount;
+	/** @brief Number of signals blocked. */
+	uint64_t blockCount;
+	/** @brief Nanoseconds spent receiving, in total. */
+	uint64_t totalNanos;
+	/** @brief Nanoseconds spent receiving one signal, at most. */
+	uint64_t maxNanos;
+	/** @brief If true, the receiver exceeded the quarantine budget, and
+	 *  now receives on a separate thread without blocking. */
+	bool quarantinedFlag;
+};
+
+/** @brief Stream a dispatch record for debugging.
+ *  @tparam OutputStream Output stream type.
+ *  @param os Output stream.
+ *  @param record Record to output.
+ *  @return Reference to the output stream.
+ */
+template <typename OutputStream>
+OutputStream &operator<<(OutputStream &os, const DispatchRecord &record)
+{
+	os << (record.signalName ? record.signalName : "(null)") << " key "
+	   << record.key << " mods " << record.mods << " at "
+	   << record.timestamp << "ns for " << record.duration << "ns";
+	if (record.blockingReceiverPtr)
+		os << " blocked by "
+		   << static_cast<const void *>(record.blockingReceiverPtr);
+	return os;
+}
+
 /**
  * @brief Interface for objects that can receive dispatched signals.
  */
@@ -31,6 +94,20 @@ class MCR_API IReceive {
 	 *  @return true to block further dispatch, false to continue.
 	 */
 	virtual bool receive(Signal *, unsigned int) = 0;
+	/** @brief Check if signals dispatched with modifiers may be
+	 *  received.
+	 *
+	 *  Dispatchers caching dispatches skip receivers that do not accept
+	 *  the modifiers.  The result must only depend on mods, and be
+	 *  re-added to the dispatcher after it changes.
+	 *  @param mods Active modifier flags.
+	 *  @return false if @ref receive never acts on these modifiers.
+	 */
+	virtual bool accepts(unsigned int mods) const
+	{
+		(void)(mods);
+		return true;
+	}
 };
 
 /**
@@ -48,8 +125,13 @@ class MCR_API IDispatcher {
 	};
 	MCR_DECL_INTERFACE(IDispatcher)
 
-	/** @brief Register a signal/receiver pair.
-	 *  @param signalPtr Signal to intercept.
+	/** @brief Register a signal/receiver pair with priority 0.
+	 *
+	 *  The receiver is notified of signals with the same type and
+	 *  @ref Signal::dispatchKey as signalPtr.  The first receiver to block
+	 *  ends dispatch.
+	 *  @param signalPtr Signal to intercept, or nullptr to receive all
+	 *  dispatched signals.
 	 *  @param receiverPtr Receiver to notify on dispatch.
 	 */
 	virtual void add(Signal *signalPtr, IReceive *receiverPtr) = 0;
@@ -100,6 +182,188 @@ class MCR_API IDispatcher {
 	{
 		return !count();
 	}
+
+	/* Appended after the original interface, to keep its layout */
+	/** @brief Register a signal/receiver pair.
+	 *
+	 *  Receivers with a higher priority receive first.  Receivers of equal
+	 *  priority receive in the order they were added.  The default
+	 *  ignores priority, and adds in order.
+	 *  @param signalPtr Signal to intercept, or nullptr to receive all
+	 *  dispatched signals.
+	 *  @param receiverPtr Receiver to notify on dispatch.
+	 *  @param priority Dispatch order, higher values first.
+	 */
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr, int priority)
+	{
+		(void)(priority);
+		add(signalPtr, receiverPtr);
+	}
+	/** @brief Dispatch a frame of signals, such as one input report.
+	 *
+	 *  Each signal is dispatched with the modifiers left by the signals
+	 *  before it.  Signals that are not blocked update the modifiers, as
+	 *  with @ref dispatchAndModify.
+	 *  @param signals Array of signals to dispatch in order.
+	 *  @param n Number of signals in the array.
+	 *  @param mods Active modifier flags before the first signal.
+	 *  @param blockedOut opt Array of n results, true for each blocked
+	 *  signal.
+	 *  @return Modifier flags after the last signal.
+	 */
+	virtual unsigned int dispatchBatch(Signal *const *signals, size_t n,
+					   unsigned int mods, bool *blockedOut)
+	{
+		for (size_t i = 0; i < n; i++) {
+			bool blocked = signals[i] &&
+				       dispatchAndModify(signals[i], &mods);
+			if (blockedOut)
+				blockedOut[i] = blocked;
+		}
+		return mods;
+	}
+	/** @brief Get the number of signals dispatched while no receiver
+	 *  could receive them.
+	 *  @return Count of unreceived dispatches, or 0 if not counted.
+	 */
+	virtual size_t unreceivedCount() const noexcept
+	{
+		return 0;
+	}
+	/** @brief Copy the most recently recorded dispatches.
+	 *  @param recordsOut Array to copy records into, oldest first.
+	 *  @param count Maximum number of records to copy.
+	 *  @return Number of records copied, 0 if not recorded.
+	 */
+	virtual size_t snapshot(DispatchRecord *recordsOut,
+				size_t count) const noexcept
+	{
+		(void)(recordsOut);
+		(void)(count);
+		return 0;
+	}
+	/** @brief Get the modifiers a key sets while pressed.
+	 *  @param key Key code.
+	 *  @return Modifier flags, 0 if none.
+	 */
+	virtual unsigned int keyModifiers(int key) const noexcept
+	{
+		(void)(key);
+		return 0;
+	}
+	/** @brief Set the modifiers a key sets while pressed.
+	 *
+	 *  @ref modifier sets these when the key is pressed, and unsets them
+	 *  when the key is released.
+	 *  @param key Key code.
+	 *  @param mods Modifier flags, 0 for none.
+	 *  @throws Error(ERANGE) if the key code cannot be tracked.
+	 */
+	virtual void setKeyModifiers(int key, unsigned int mods)
+	{
+		(void)(key);
+		(void)(mods);
+	}
+	/** @brief Check if time spent by each receiver is accounted.
+	 *  @return true if receivers are timed.
+	 */
+	virtual bool statsFlag() const noexcept
+	{
+		return false;
+	}
+	/** @brief Enable or disable timing each receiver.
+	 *  @param flag true to time receivers.
+	 */
+	virtual void setStatsFlag(bool flag) noexcept
+	{
+		(void)(flag);
+	}
+	/** @brief Check if dispatches are cached.
+	 *  @return true if repeated dispatches are cached.
+	 */
+	virtual bool cacheFlag() const noexcept
+	{
+		return false;
+	}
+	/** @brief Enable or disable caching dispatches.
+	 *
+	 *  Receivers accepting each (signal, modifiers) pair, see
+	 *  @ref IReceive::accepts, are cached until receivers are added or
+	 *  removed.  Repeated dispatches, such as key repeat, skip receivers
+	 *  that do not accept the modifiers without calling them.
+	 *  @param flag true to cache dispatches.
+	 */
+	virtual void setCacheFlag(bool flag) noexcept
+	{
+		(void)(flag);
+	}
+	/** @brief Microseconds a timed receiver may take to receive one
+	 *  signal, before it is quarantined.
+	 *  @return Quarantine budget, 0 never quarantines.
+	 */
+	virtual unsigned int quarantineMicros() const noexcept
+	{
+		return 0;
+	}
+	/** @brief Set microseconds a timed receiver may take to receive one
+	 *  signal, before it is quarantined.
+	 *
+	 *  Quarantined receivers receive a copy of the signal on a separate
+	 *  thread, see @ref Signal::copy, and can no longer block.  Signals
+	 *  that cannot be copied are received on the dispatching thread, still
+	 *  without blocking.  Removing a quarantined receiver drops its waiting
+	 *  signals without waiting for the separate thread.
+	 *  @param micros Quarantine budget, 0 never quarantines.
+	 */
+	virtual void setQuarantineMicros(unsigned int micros)
+	{
+		(void)(micros);
+	}
+	/** @brief Get the time spent by one receiver.
+	 *  @param receiverPtr Registered receiver.
+	 *  @param statsOut Receiver statistics, set if found.
+	 *  @return true if the receiver is registered and accounted.
+	 */
+	virtual bool receiverStats(const IReceive *receiverPtr,
+				   ReceiverStats *statsOut) const noexcept
+	{
+		(void)(receiverPtr);
+		(void)(statsOut);
+		return false;
+	}
+	/** @brief Check if dispatches are recorded for @ref snapshot.
+	 *  @return true if recording.
+	 */
+	virtual bool recordFlag() const noexcept
+	{
+		return false;
+	}
+	/** @brief Enable or disable recording dispatches.
+	 *
+	 *  Recording reads the clock twice for each dispatch, so it is
+	 *  disabled by default.
+	 *  @param flag true to record dispatches.
+	 */
+	virtual void setRecordFlag(bool flag) noexcept
+	{
+		(void)(flag);
+	}
+	/** @brief Remove one signal/receiver pair, and keep the other
+	 *  registrations of the receiver.
+	 *
+	 *  The default removes nothing, for dispatchers that can only
+	 *  remove a receiver from all registrations.
+	 *  @param signalPtr Signal the receiver was added with, or nullptr
+	 *  if added to receive all dispatched signals.
+	 *  @param receiverPtr Receiver to unregister.
+	 *  @return false if not supported, and nothing was removed.
+	 */
+	virtual bool remove(Signal *signalPtr, IReceive *receiverPtr)
+	{
+		(void)(signalPtr);
+		(void)(receiverPtr);
+		return false;
+	}
 };
 }
 
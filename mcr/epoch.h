@@ -0,0 +1,139 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Epoch - Reclaim read-copy-update memory once no thread
+ *  reads it
+ */
+
+#pragma once
+
+#include "mcr/api.h"
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mcr
+{
+/**
+ * @brief Epoch-based reclamation, shared by every read-copy-update
+ * structure of the process.
+ *
+ *  Readers enter before loading a published pointer, and leave after they
+ *  are done with it.  Entering stores the global epoch into a record of
+ *  the calling thread, so readers never write shared memory.  Writers
+ *  publish a replacement, tag the replaced memory with @ref retire, and
+ *  free it once @ref quiescent.  Only writers scan the records of all
+ *  threads.
+ *
+ *  Entering is nestable, and a thread keeps the epoch it entered first.
+ *  Writers keep replaced memory in a @ref RetireList.
+ */
+class MCR_API Epoch {
+    public:
+	/*! Reads while in scope */
+	class Guard {
+	    public:
+		Guard() noexcept
+		{
+			Epoch::enter();
+		}
+		Guard(const Guard &) = delete;
+		~Guard()
+		{
+			Epoch::leave();
+		}
+		Guard &operator=(const Guard &) = delete;
+	};
+	/**
+	 * @brief Replaced memory of one writer, freed in the order retired
+	 * once quiescent.
+	 *
+	 *  Writers are serialized.  Reserve before publishing, so retiring
+	 *  the replaced memory after cannot fail.
+	 *  @tparam T Type deleted once quiescent.
+	 */
+	template <typename T> class RetireList {
+	    public:
+		RetireList() = default;
+		RetireList(const RetireList &) = delete;
+		/*! Frees all memory, no thread may read it */
+		~RetireList()
+		{
+			for (auto &retired : _retired)
+				delete retired.ptr;
+		}
+		RetireList &operator=(const RetireList &) = delete;
+
+		/*! Reserve one retire, before publishing */
+		inline void reserve()
+		{
+			_retired.reserve(_retired.size() + 1);
+		}
+		/*! Tag replaced memory, leaked if not reserved and out of
+		 *  memory, rather than freed while read */
+		void retire(const T *ptr) noexcept
+		{
+			if (!ptr)
+				return;
+			try {
+				_retired.push_back(
+					Retired{ Epoch::retire(), ptr, SIZE_MAX });
+			} catch (...) {
+			}
+		}
+		/** @brief Free quiescent memory in the order retired, unless
+		 *  held.
+		 *  @param heldFn `bool(size_t &mark)` of quiescent memory in
+		 *  order, true keeps it and all retired after.  The mark is
+		 *  SIZE_MAX until set, such as a position to wait for.
+		 */
+		template <typename HeldFn> void reclaim(HeldFn heldFn) noexcept
+		{
+			/* Retired in order, so tags are ascending. */
+			auto end = _retired.begin();
+			for (; end != _retired.end() && Epoch::quiescent(end->tag);
+			     ++end) {
+				if (heldFn(end->mark))
+					break;
+				delete end->ptr;
+			}
+			_retired.erase(_retired.begin(), end);
+		}
+		/*! Free quiescent memory in the order retired */
+		inline void reclaim() noexcept
+		{
+			reclaim([](size_t &) { return false; });
+		}
+
+	    private:
+		struct Retired {
+			uint64_t tag;
+			const T *ptr;
+			size_t mark;
+		};
+		std::vector<Retired> _retired;
+	};
+
+	/*! Start reading on this thread */
+	static void enter() noexcept;
+	/*! Stop reading on this thread */
+	static void leave() noexcept;
+	/** @brief Tag memory after it is replaced, it may still be read
+	 *  until quiescent.
+	 *  @return Retire tag.
+	 */
+	static uint64_t retire() noexcept;
+	/** @brief Check if memory may be freed.
+	 *  @param tag Retire tag of the memory.
+	 *  @return true if every reader that may read it has left.
+	 */
+	static bool quiescent(uint64_t tag) noexcept;
+};
+}
+
+#endif
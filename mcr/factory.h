@@ -19,6 +19,8 @@
 #include "mcr/signal_registry.h"
 #include "mcr/trigger_registry.h"
 #include "mcr/dispatcher.h"
+#include "mcr/dispatch_queue.h"
+#include "mcr/timer.h"
 
 #ifdef __cplusplus
 
@@ -55,6 +57,56 @@ createContext(bool enabled = true);
  */
 MCR_API std::shared_ptr<Libmacro> createContextShared(bool enabled = true);
 
+/** @brief Create a dispatcher that dispatches on its own thread.
+ *  @param target Dispatcher to dispatch to on the dispatch thread, not
+ *  owned.
+ *  @param capacity Maximum queued signals, rounded up to a power of 2.
+ *  @return Unique pointer to the new dispatch queue.
+ */
+MCR_API std::unique_ptr<IDispatchQueue, IDispatcher::Deleter>
+createDispatchQueue(IDispatcher *target,
+		    size_t capacity = MCR_DISPATCH_QUEUE_SIZE);
+/** @brief Create a shared dispatcher that dispatches on its own thread.
+ *  @param target Dispatcher to dispatch to on the dispatch thread, not
+ *  owned.
+ *  @param capacity Maximum queued signals, rounded up to a power of 2.
+ *  @return Shared pointer to the new dispatch queue.
+ */
+MCR_API std::shared_ptr<IDispatchQueue>
+createDispatchQueueShared(IDispatcher *target,
+			  size_t capacity = MCR_DISPATCH_QUEUE_SIZE);
+/** @brief Create a dispatcher with one dispatch thread per shard of
+ *  signal sources.
+ *  @param target Dispatcher to dispatch to on the shard threads, not
+ *  owned.
+ *  @param shardCount Number of shards, 0 for one per hardware thread.
+ *  @param capacity Maximum queued signals of each shard.
+ *  @return Unique pointer to the new sharded dispatcher.
+ */
+MCR_API std::unique_ptr<IShardedDispatcher, IDispatcher::Deleter>
+createShardedDispatcher(IDispatcher *target, size_t shardCount = 0,
+			size_t capacity = MCR_DISPATCH_QUEUE_SIZE);
+/** @brief Create a shared dispatcher with one dispatch thread per shard
+ *  of signal sources.
+ *  @param target Dispatcher to dispatch to on the shard threads, not
+ *  owned.
+ *  @param shardCount Number of shards, 0 for one per hardware thread.
+ *  @param capacity Maximum queued signals of each shard.
+ *  @return Shared pointer to the new sharded dispatcher.
+ */
+MCR_API std::shared_ptr<IShardedDispatcher>
+createShardedDispatcherShared(IDispatcher *target, size_t shardCount = 0,
+			      size_t capacity = MCR_DISPATCH_QUEUE_SIZE);
+
+/** @brief Create a timer that acts on its own thread.
+ *  @return Unique pointer to the new timer.
+ */
+MCR_API std::unique_ptr<ITimer, ITimer::Deleter> createTimer();
+/** @brief Create a shared timer that acts on its own thread.
+ *  @return Shared pointer to the new timer.
+ */
+MCR_API std::shared_ptr<ITimer> createTimerShared();
+
 } /* namespace factory */
 
 /*! @brief Used internally by this library. Not intended as public API. */
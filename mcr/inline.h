@@ -50,23 +50,24 @@ static MCR_INLINE bool mcr_TriggerMode_match_inl(unsigned int triggerMode,
 		// Obviously?
 		return matchingFlags != incomingFlags;
 		break;
-	// case MCR_TM_EQUAL_OR_NONE:
-	//  // Equal or at least none of these flags
-	//  return matchingFlags == incomingFlags || (matchingFlags & incomingFlags) == 0;
-	//  break;
-	// case MCR_TM_SOME:
-	//  // Has some, not all. Inequal, exclusive, and has matching flags.
-	//  // Note, 0 modifiers cannot "some" anything.
-	//  return matchingFlags != incomingFlags &&
-	//      (matchingFlags | incomingFlags) == matchingFlags &&
-	//      (matchingFlags & incomingFlags) != 0;
-	//  break;
-	// case MCR_TM_MATCH:
-	//  // Has some, or all. Exclusive and has matching flags.
-	//  // Note, 0 modifiers cannot "match" to anything.
-	//  return (matchingFlags | incomingFlags) == matchingFlags &&
-	//      (matchingFlags & incomingFlags) != 0;
-	//  break;
+	case MCR_TM_EQUAL_OR_NONE:
+		// Equal or at least none of these flags
+		return matchingFlags == incomingFlags ||
+		       (matchingFlags & incomingFlags) == 0;
+		break;
+	case MCR_TM_SOME:
+		// Has some, not all. Inequal, exclusive, and has matching flags.
+		// Note, 0 modifiers cannot "some" anything.
+		return matchingFlags != incomingFlags &&
+		       (matchingFlags | incomingFlags) == matchingFlags &&
+		       (matchingFlags & incomingFlags) != 0;
+		break;
+	case MCR_TM_MATCH:
+		// Has some, or all. Exclusive and has matching flags.
+		// Note, 0 modifiers cannot "match" to anything.
+		return (matchingFlags | incomingFlags) == matchingFlags &&
+		       (matchingFlags & incomingFlags) != 0;
+		break;
 	case MCR_TM_ANY:
 		return (matchingFlags & incomingFlags) != 0;
 		break;
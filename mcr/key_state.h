@@ -0,0 +1,100 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref KeyState - Pressed keys of a Libmacro context
+ */
+
+#pragma once
+
+#include "mcr/defines.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mcr
+{
+class Signal;
+
+/**
+ * @brief Pressed keys and when they were pressed.
+ *
+ *  A fixed bitset of key codes below @ref MCR_KEY_STATE_COUNT, 64 keys per
+ *  word.  Every word and press time is atomic, so keys may be tested from
+ *  any thread while dispatch updates them.
+ */
+class MCR_API KeyState {
+    public:
+	/*! Words in the pressed key bitset */
+	static const size_t WORD_COUNT = (MCR_KEY_STATE_COUNT + 63) / 64;
+
+	KeyState() = default;
+	KeyState(const KeyState &) = delete;
+	KeyState &operator=(const KeyState &) = delete;
+
+	/** @brief Check if a key is pressed.
+	 *  @param key Key code, false if out of range.
+	 */
+	inline bool pressed(int key) const noexcept
+	{
+		const auto index = static_cast<unsigned int>(key);
+		return index < MCR_KEY_STATE_COUNT &&
+		       (word(index / 64) & (uint64_t(1) << (index % 64)));
+	}
+	/** @brief 64 keys starting at key code index * 64.
+	 *  @param index Word index, less than @ref WORD_COUNT.
+	 */
+	inline uint64_t word(size_t index) const noexcept
+	{
+		return _words[index].load(std::memory_order_acquire);
+	}
+	/** @brief Steady clock nanoseconds when a key was last pressed.
+	 *  @param key Key code, 0 if out of range.
+	 */
+	inline uint64_t pressTime(int key) const noexcept
+	{
+		const auto index = static_cast<unsigned int>(key);
+		return index < MCR_KEY_STATE_COUNT ?
+			       _pressTimes[index].load(
+				       std::memory_order_relaxed) :
+			       0;
+	}
+	/** @brief Press or release a key.  Out of range keys are ignored,
+	 *  and pressing a pressed key keeps its press time.
+	 *  @param key Key code.
+	 *  @param pressedFlag true to press, false to release.
+	 *  @param timestamp Steady clock nanoseconds of a press.
+	 */
+	void set(int key, bool pressedFlag, uint64_t timestamp) noexcept;
+	/** @brief Update from a dispatched key, see @ref Signal::keyPress.
+	 *
+	 *  @ref MCR_SET presses, @ref MCR_UNSET releases and @ref MCR_TOGGLE
+	 *  flips the key.  @ref MCR_BOTH presses, and the key is released
+	 *  by @ref release after dispatch.
+	 *  @param signalPtr Dispatched signal.
+	 *  @return true if the signal is a key.
+	 */
+	bool press(const Signal *signalPtr) noexcept;
+	/** @brief Release a key pressed and released by one signal,
+	 *  @ref MCR_BOTH, after it was dispatched.
+	 *  @param signalPtr Dispatched signal.
+	 */
+	void release(const Signal *signalPtr) noexcept;
+	/*! Release all keys */
+	void clear() noexcept;
+
+	/*! Steady clock nanoseconds */
+	static uint64_t now() noexcept;
+
+    private:
+	std::atomic<uint64_t> _words[WORD_COUNT] = {};
+	std::atomic<uint64_t> _pressTimes[MCR_KEY_STATE_COUNT] = {};
+};
+}
+
+#endif
@@ -22,16 +22,19 @@
 #include "mcr/trigger_registry.h"
 #include "mcr/serial.h"
 #include "mcr/dispatcher.h"
+#include "mcr/debounce.h"
+#include "mcr/key_state.h"
+#include "mcr/timer.h"
 
 #ifdef __cplusplus
 
 /*! @namespace mcr
 *  @brief Libmacro, by Jonathan Pelletier, New Paradigm Software. Alpha version.
 *
-*  1. @ref ISignal is dispatched to @ref IDispatcher using @ref Libmacro::dispatch. @n
-*       1.0.a Disable dispatch for a signal by setting @ref ISignal.dispatchFlag to false. @n
-*       1.0.b Disable dispatch for all of an ISignal type by setting @ref TODOISignal.dispatcher to NULL. @n
-*       1.0.c Disable Libmacro generic dispatch (receive all types) by setting @ref mcr_context.base.generic_dispatch.flag to false. @n
+*  1. @ref Signal is dispatched to @ref IDispatcher using @ref Libmacro::dispatch. @n
+*       1.0.a Disable dispatch for a signal by setting @ref Signal::dispatchFlag to false. @n
+*       1.0.b Disable dispatch for all of a Signal type by setting @ref Signal::dispatcherPtr to NULL. @n
+*       1.0.c Disable Libmacro generic dispatch (receive all types) by setting @ref Libmacro::setGenericDispatchFlag to false. @n
 *   1.1 Dispatching may be received by @ref mcr_DispatchReceiver. @n
 *   1.2 @ref mcr_Trigger_receive may be used to dispatch into @ref mcr_Trigger. @n
 *   1.3 Triggered action may be a @ref mcr_Macro, which sends a list of @ref ISignal. @n
@@ -145,6 +148,69 @@ class MCR_API Libmacro {
 	 *  @param val New global thread limit.
 	 */
 	void setGlobalThreadLimit(unsigned int val);
+
+	/* Appended after the original interface, to keep its layout */
+	/** @brief Dispatch a signal, and send it if not blocked.
+	 *
+	 *  If @ref Signal::dispatchFlag is set the signal is dispatched to
+	 *  @ref Signal::dispatcherPtr, then to the generic dispatcher if
+	 *  @ref genericDispatchFlag is set.  If neither blocks, the
+	 *  dispatcher updates @ref modifiers.  Unblocked signals are then
+	 *  sent.  Signals without dispatchFlag are only sent.
+	 *
+	 *  Signals dispatched from inside dispatch, such as by receivers, are
+	 *  copied onto the thread's work list, see @ref Signal::copy.  The
+	 *  outermost dispatch of the thread dispatches the copies in order
+	 *  before returning.  A queued dispatch returns false at once, and its
+	 *  decision is not reported.  Signals that cannot be copied are
+	 *  dispatched at once instead, and return their decision.  Signals
+	 *  nested deeper than @ref dispatchDepthMax, or beyond
+	 *  @ref MCR_DISPATCH_WORK_MAX waiting, are dropped and counted.
+	 *  @param signalPtr Signal to dispatch and send.
+	 *  @return true if dispatch was blocked and the signal not sent, false
+	 *  if sent or queued.
+	 */
+	virtual bool dispatch(Signal *signalPtr) = 0;
+	/** @brief Get the maximum nesting of signals dispatched from inside
+	 *  dispatch.
+	 *  @return Maximum depth, 0 drops all nested dispatches.
+	 */
+	virtual unsigned int dispatchDepthMax() const = 0;
+	/** @brief Set the maximum nesting of signals dispatched from inside
+	 *  dispatch.
+	 *  @param depth Maximum depth, 0 drops all nested dispatches.
+	 */
+	virtual void setDispatchDepthMax(unsigned int depth) = 0;
+	/** @brief Get the number of nested dispatches dropped for exceeding
+	 *  the depth or work list limits.
+	 *  @return Count of dropped dispatches.
+	 */
+	virtual size_t droppedDispatchCount() const = 0;
+	/** @brief Get the keys pressed by dispatched signals.
+	 *
+	 *  Keys are pressed before they are dispatched to receivers, and
+	 *  keys that are pressed and released together, @ref MCR_BOTH, are
+	 *  released after.
+	 *  @return Reference to the key state.
+	 */
+	virtual KeyState &keyState() = 0;
+	virtual const KeyState &keyState() const = 0;
+	/** @brief Get the timer shared by triggers of this context.
+	 *
+	 *  Triggers waiting for a timeout, such as @ref TapHold, schedule
+	 *  it here instead of starting threads.
+	 *  @return Reference to the timer.
+	 */
+	virtual ITimer &timer() = 0;
+	/** @brief Get the debounce of dispatched keys.
+	 *
+	 *  Dispatched keys that chatter are dropped before the key state
+	 *  and receivers, and are not sent.  The window starts at 0, which
+	 *  debounces nothing.
+	 *  @return Reference to the debounce.
+	 */
+	virtual Debounce &debounce() = 0;
+	virtual const Debounce &debounce() const = 0;
 };
 }
 #endif
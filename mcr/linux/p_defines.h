@@ -13,4 +13,17 @@
 
 // Use default MCR_EXPORT and MCR_IMPORT, detecting GCC or Clang.
 
-
+/*! Default { key code, @ref mcr_ModFlags } pairs, tracked by
+ *  @ref mcr::IDispatcher::modifier.  Key codes are from
+ *  linux/input-event-codes.h. */
+#define MCR_KEY_MODIFIER_DEFAULTS                                        \
+	{ 29, MCR_CTRL }, /* KEY_LEFTCTRL */                             \
+	{ 97, MCR_CTRL }, /* KEY_RIGHTCTRL */                            \
+	{ 42, MCR_SHIFT }, /* KEY_LEFTSHIFT */                           \
+	{ 54, MCR_SHIFT }, /* KEY_RIGHTSHIFT */                          \
+	{ 56, MCR_ALT }, /* KEY_LEFTALT */                               \
+	{ 100, MCR_ALTGR }, /* KEY_RIGHTALT */                           \
+	{ 125, MCR_META }, /* KEY_LEFTMETA */                            \
+	{ 126, MCR_META }, /* KEY_RIGHTMETA */                           \
+	{ 127, MCR_COMPOSE }, /* KEY_COMPOSE */                          \
+	{ 0x1d0, MCR_FN } /* KEY_FN */
@@ -10,8 +10,13 @@
 #pragma once
 
 #include "mcr/api.h"
+#include "mcr/types.h"
 
 #ifdef __cplusplus
+#include <cstddef>
+#include <new>
+#include <typeinfo>
+
 #include "mcr/template/list.h"
 namespace mcr
 {
@@ -31,6 +36,10 @@ class MCR_API Signal {
 	IDispatcher *dispatcherPtr = nullptr;
 	/** @brief If true, dispatch is enabled for this signal. */
 	bool dispatchFlag = false;
+	/** @brief Device or other source of this signal, 0 if unknown.
+	 *  Sharded dispatch keeps signals of one source in order.
+	 */
+	size_t source = 0;
 
 	/** @brief Get the unique name of this signal type.
 	 *  @return Null-terminated string identifying the signal type.
@@ -45,8 +54,115 @@ class MCR_API Signal {
 		(void)(aliasNumber);
 		return nullptr;
 	}
+	/** @brief Key of this signal within its type, used to index dispatch.
+	 *
+	 *  Receivers added for a signal only receive signals of the same
+	 *  type with an equal key.  By default all signals of a type share
+	 *  the same key.
+	 *  @return Dispatch key of this signal.
+	 */
+	virtual size_t dispatchKey() const
+	{
+		return 0;
+	}
+	/** @brief Key pressed or released by this signal, to track
+	 *  modifiers.
+	 *  @param keyOut Set to the key code, if a key.
+	 *  @param applyOut Set to the key press, if a key.
+	 *  @return true if this signal is a key.
+	 */
+	virtual bool keyPress(int *keyOut, mcr_ApplyValue *applyOut) const
+	{
+		(void)(keyOut);
+		(void)(applyOut);
+		return false;
+	}
+	/** @brief Position moved to or by this signal, to track motion.
+	 *  @param positionOut Set to the position, if motion.
+	 *  @param relativeOut Set to true if the position is relative to
+	 *  the current position, if motion.
+	 *  @return true if this signal is motion.
+	 */
+	virtual bool motion(SpacePosition *positionOut, bool *relativeOut) const
+	{
+		(void)(positionOut);
+		(void)(relativeOut);
+		return false;
+	}
 	/** @brief Send this signal, performing its associated action. */
 	virtual void send() = 0;
+	/** @brief Copy this signal into memory, to dispatch it later.
+	 *
+	 *  Signals dispatched on another thread are copied, because the
+	 *  original may be gone before it is received.  Signals that cannot
+	 *  be copied are dispatched on the calling thread instead.
+	 *  @param memory Aligned to std::max_align_t.
+	 *  @param size Bytes of memory.
+	 *  @return Copy constructed in memory, or nullptr if this signal
+	 *  cannot be copied, or does not fit.
+	 */
+	virtual Signal *copy(void *memory, size_t size) const
+	{
+		(void)(memory);
+		(void)(size);
+		return nullptr;
+	}
+
+    protected:
+	/** @brief Copy a signal of exactly type SignalT into memory.
+	 *  @return Copy, or nullptr if signal is a subclass of SignalT, which
+	 *  would be sliced, or does not fit.
+	 */
+	template <class SignalT>
+	static Signal *copyAs(const SignalT &signal, void *memory, size_t size)
+	{
+		if (typeid(signal) != typeid(SignalT) ||
+		    sizeof(SignalT) > size ||
+		    alignof(SignalT) > alignof(std::max_align_t))
+			return nullptr;
+		return new (memory) SignalT(signal);
+	}
+};
+
+/**
+ * @brief Owns a copy of a signal, without allocating.
+ *
+ *  See @ref Signal::copy.
+ */
+class MCR_API SignalCopy {
+    public:
+	SignalCopy() = default;
+	SignalCopy(const SignalCopy &other)
+	{
+		assign(other.get());
+	}
+	~SignalCopy()
+	{
+		reset();
+	}
+	SignalCopy &operator=(const SignalCopy &other)
+	{
+		if (&other != this)
+			assign(other.get());
+		return *this;
+	}
+
+	/** @brief Replace the owned copy.
+	 *  @param signalPtr Signal to copy, or nullptr to own nothing.
+	 *  @return false if the signal cannot be copied, nothing is owned.
+	 */
+	bool assign(const Signal *signalPtr) noexcept;
+	/** @brief Destroy the owned copy. */
+	void reset() noexcept;
+	/** @brief Owned copy. @return Copy, or nullptr if empty. */
+	inline Signal *get() const noexcept
+	{
+		return _signalPtr;
+	}
+
+    private:
+	alignas(std::max_align_t) unsigned char _memory[MCR_SIGNAL_COPY_SIZE];
+	Signal *_signalPtr = nullptr;
 };
 
 template struct MCR_API List<Signal>;
@@ -47,6 +47,10 @@ public:
 		if (_fn)
 			_fn();
 	}
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
 
 private:
 	std::function<void()> _fn;
@@ -77,6 +77,10 @@ class MCR_API Interrupt : public Signal {
 		if (target)
 			target->interrupt(value);
 	}
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
 };
 }
 #endif
@@ -0,0 +1,81 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Key - Signal to press or release a keyboard key
+ */
+
+#pragma once
+
+#include "mcr/signal.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+namespace mcr
+{
+/**
+ * @brief Signal that presses or releases a keyboard key.
+ *
+ *  Keys are dispatched by key code.  Dispatchers track modifiers from the
+ *  keys they dispatch, see @ref IDispatcher::setKeyModifiers.
+ */
+class MCR_API Key : public Signal {
+    public:
+	MCR_DECL_INTERFACE(Key)
+
+	/*! Platform key code */
+	int key = 0;
+	/*! @ref MCR_SET presses, @ref MCR_UNSET releases, @ref MCR_BOTH
+	 *  presses and then releases */
+	enum mcr_ApplyValue apply = MCR_BOTH;
+
+	/** @brief Platform layer that sends keys, mcr_Key_send_member in
+	 *  docs/platform.md.  nullptr without a platform, keys may then be
+	 *  dispatched but not sent.  Set before sending any key.
+	 */
+	static void (*platformSend)(const Key &keySignal);
+
+	/** @brief Construct a key signal.
+	 *  @param keyCode Platform key code.
+	 *  @param applyValue Press, release, or both.
+	 */
+	Key(int keyCode, mcr_ApplyValue applyValue = MCR_BOTH)
+		: Signal()
+		, key(keyCode)
+		, apply(applyValue)
+	{
+	}
+
+	/** @brief Get the signal type name. @return "Key". */
+	virtual const char *name() const override
+	{
+		return "Key";
+	}
+	/** @brief Keys are dispatched by key code.
+	 *  @return @ref key
+	 */
+	virtual size_t dispatchKey() const override
+	{
+		return static_cast<unsigned int>(key);
+	}
+	virtual bool keyPress(int *keyOut,
+			      mcr_ApplyValue *applyOut) const override
+	{
+		*keyOut = key;
+		*applyOut = apply;
+		return true;
+	}
+	/** @brief Send this signal to the platform keyboard.
+	 *  @throws Error(ENOTSUP) if no platform sends keys, see
+	 *  @ref platformSend.
+	 */
+	virtual void send() override;
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
+};
+}
+#endif
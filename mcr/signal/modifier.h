@@ -48,8 +48,19 @@ class MCR_API Modifier : public Signal {
 	{
 		return "Modifier";
 	}
+	/** @brief Modifiers are dispatched by their modifier bits.
+	 *  @return @ref modifiers
+	 */
+	virtual size_t dispatchKey() const override
+	{
+		return modifiers;
+	}
 	/** @brief Send this signal, applying the modifier changes to the context. */
 	virtual void send();
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
 };
 }
 #endif
@@ -0,0 +1,74 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref MoveCursor - Signal to move the cursor
+ */
+
+#pragma once
+
+#include "mcr/signal.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+namespace mcr
+{
+/**
+ * @brief Signal that moves the cursor, or another pointer with up to
+ * @ref MCR_DIMENSION_COUNT axes.
+ */
+class MCR_API MoveCursor : public Signal {
+    public:
+	MCR_DECL_INTERFACE(MoveCursor)
+
+	/*! Position to move to, or by if justified */
+	SpacePosition position = NEW_mcr_SpacePosition;
+	/*! true to move relative to the current position */
+	bool justifyFlag = false;
+
+	/** @brief Platform layer that moves the cursor,
+	 *  mcr_MoveCursor_send_member in docs/platform.md.  nullptr without
+	 *  a platform, motion may then be dispatched but not sent.  Set
+	 *  before sending any motion.
+	 */
+	static void (*platformSend)(const MoveCursor &moveCursorSignal);
+
+	/** @brief Construct a cursor motion.
+	 *  @param x First dimension.
+	 *  @param y Second dimension.
+	 *  @param justify true to move relative to the current position.
+	 */
+	MoveCursor(long long x, long long y, bool justify = true)
+		: Signal()
+		, justifyFlag(justify)
+	{
+		position.array[MCR_X] = x;
+		position.array[MCR_Y] = y;
+	}
+
+	/** @brief Get the signal type name. @return "MoveCursor". */
+	virtual const char *name() const override
+	{
+		return "MoveCursor";
+	}
+	virtual bool motion(SpacePosition *positionOut,
+			    bool *relativeOut) const override
+	{
+		*positionOut = position;
+		*relativeOut = justifyFlag;
+		return true;
+	}
+	/** @brief Send this signal to the platform cursor.
+	 *  @throws Error(ENOTSUP) if no platform moves the cursor, see
+	 *  @ref platformSend.
+	 */
+	virtual void send() override;
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
+};
+}
+#endif
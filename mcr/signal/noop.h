@@ -36,6 +36,10 @@ class MCR_API NoOp : public Signal {
 	}
 	/** @brief Send this signal, pausing execution for the configured duration. */
 	virtual void send();
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
 };
 }
 #endif
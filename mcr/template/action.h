@@ -0,0 +1,94 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file mcr/template/action.h
+ *  @brief @ref TAction - Conditional trigger with a trigger mode chosen at
+ *  compile time.
+ */
+
+#pragma once
+
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+namespace mcr
+{
+/** @brief Match modifiers with one @ref mcr_TriggerMode, without
+ *  branching.
+ *
+ *  Matches the same as @ref mcr_TriggerMode_match_inl.  User trigger
+ *  modes never match.
+ *  @tparam Mode Trigger mode.
+ *  @param modifiers Modifiers that must be matched.
+ *  @param mods Modifiers intercepted.
+ *  @return true if mods match modifiers.
+ */
+template <unsigned int Mode>
+constexpr bool triggerModeMatch(unsigned int modifiers,
+				unsigned int mods) noexcept
+{
+	/* Bitwise & and | on bool do not short-circuit. */
+	if constexpr (Mode == MCR_TM_EQUAL) {
+		return modifiers == mods;
+	} else if constexpr (Mode == MCR_TM_ALL) {
+		return (modifiers & mods) == modifiers;
+	} else if constexpr (Mode == MCR_TM_NONE) {
+		return (modifiers & mods) == 0;
+	} else if constexpr (Mode == MCR_TM_EXCLUSIVE) {
+		return (mods & ~modifiers) == 0;
+	} else if constexpr (Mode == MCR_TM_INEQUAL) {
+		return modifiers != mods;
+	} else if constexpr (Mode == MCR_TM_MATCH) {
+		return ((mods & ~modifiers) == 0) & ((modifiers & mods) != 0);
+	} else if constexpr (Mode == MCR_TM_ANY) {
+		return (modifiers & mods) != 0;
+	} else if constexpr (Mode == MCR_TM_EQUAL_OR_NONE) {
+		return (modifiers == mods) | ((modifiers & mods) == 0);
+	} else if constexpr (Mode == MCR_TM_SOME) {
+		return (modifiers != mods) & ((mods & ~modifiers) == 0) &
+		       ((modifiers & mods) != 0);
+	} else {
+		(void)(modifiers);
+		(void)(mods);
+		return false;
+	}
+}
+
+/**
+ * @brief Conditional trigger from intercepted modifiers, with the trigger
+ * mode chosen at compile time.
+ *
+ *  Same as @ref Action, but matching is one inlined mask compare.
+ *
+ *  @tparam Mode @ref mcr_TriggerMode
+ */
+template <mcr_TriggerMode Mode> class TAction : public Trigger {
+    public:
+	/*! @ref mcr_ModFlags Default MCR_MF_NONE */
+	unsigned int modifiers = 0;
+
+	TAction(unsigned int matchModifiers = 0) : modifiers(matchModifiers)
+	{
+	}
+
+	virtual const char *name() const override
+	{
+		return "Action";
+	}
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override
+	{
+		if (!triggerModeMatch<Mode>(modifiers, mods))
+			return false;
+		return trigger(signalPtr, mods);
+	}
+	virtual bool accepts(unsigned int mods) const override
+	{
+		return triggerModeMatch<Mode>(modifiers, mods);
+	}
+};
+}
+
+#endif
@@ -0,0 +1,252 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file mcr/template/dispatcher.h
+ *  @brief @ref TDispatcher - Dispatcher for one signal type, calling its
+ *  receivers without virtual dispatch.
+ */
+
+#pragma once
+
+#include "mcr/dispatcher.h"
+#include "mcr/error.h"
+#include "mcr/signal.h"
+
+#ifdef __cplusplus
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace mcr
+{
+/**
+ * @brief Receiver of one signal type, called directly by @ref TDispatcher.
+ *
+ *  DerivedT implements `bool receiveSignal(SignalT &, unsigned int)`.  As
+ *  an @ref IReceive it also receives from any other dispatcher, ignoring
+ *  signals that are not a SignalT.
+ *
+ *  @tparam SignalT Signal type to receive.
+ *  @tparam DerivedT Receiver class deriving from this template.
+ */
+template <typename SignalT, typename DerivedT>
+class TReceive : public IReceive {
+    public:
+	typedef SignalT signal_type;
+
+	/** @brief Receive a signal dispatched through @ref IDispatcher.
+	 *  @param signalPtr The signal being dispatched.
+	 *  @param mods Active modifier flags.
+	 *  @return true to block further dispatch, false to continue.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override
+	{
+		auto typedPtr = dynamic_cast<SignalT *>(signalPtr);
+		return typedPtr && static_cast<DerivedT *>(this)->receiveSignal(
+					   *typedPtr, mods);
+	}
+};
+
+/**
+ * @brief Dispatcher for one signal type and one receiver type.
+ *
+ *  Dispatching a SignalT reference calls ReceiverT::receiveSignal directly,
+ *  so the compiler may inline the whole dispatch when ReceiverT is a
+ *  final class.  As an @ref IDispatcher it can be set as the
+ *  @ref Signal::dispatcherPtr, and dispatches signals of other types to
+ *  nobody.
+ *
+ *  Order and blocking are the same as @ref IDispatcher::add.  Unlike the
+ *  generic dispatcher, receivers must not be added or removed while
+ *  dispatching.
+ *
+ *  @tparam SignalT Signal type to dispatch.
+ *  @tparam ReceiverT Receiver type, implementing
+ *  `bool receiveSignal(SignalT &, unsigned int)`.
+ */
+template <typename SignalT, typename ReceiverT>
+class TDispatcher : public IDispatcher {
+	static_assert(std::is_base_of<Signal, SignalT>::value,
+		      "SignalT must be a Signal");
+	static_assert(std::is_base_of<IReceive, ReceiverT>::value,
+		      "ReceiverT must be an IReceive");
+
+    public:
+	TDispatcher() = default;
+	TDispatcher(const TDispatcher &) = delete;
+	virtual ~TDispatcher() override = default;
+	TDispatcher &operator=(const TDispatcher &) = delete;
+
+	using IDispatcher::add;
+	/** @brief Register a signal/receiver pair.
+	 *  @param signalPtr Signal to intercept, or nullptr to receive all
+	 *  signals of type SignalT.
+	 *  @param receiverPtr Receiver to notify on dispatch.
+	 *  @param priority Dispatch order, higher values first.
+	 */
+	void add(const SignalT *signalPtr, ReceiverT *receiverPtr,
+		 int priority = 0)
+	{
+		if (!receiverPtr)
+			return;
+		const bool genericFlag = !signalPtr;
+		const size_t key =
+			genericFlag ? 0 : signalPtr->SignalT::dispatchKey();
+		auto &list = genericFlag ? _genericReceivers : _receivers;
+		erase(list, key, receiverPtr);
+		Entry entry{key, receiverPtr, priority, _sequence++};
+		list.insert(std::upper_bound(list.begin(), list.end(), entry,
+					     Entry::before),
+			    entry);
+	}
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		add(signalPtr, receiverPtr, 0);
+	}
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr,
+			 int priority) override
+	{
+		SignalT *typedPtr = nullptr;
+		if (signalPtr && !(typedPtr = dynamic_cast<SignalT *>(signalPtr)))
+			throw Error(EINVAL, "Signal type is not dispatched");
+		if (!receiverPtr)
+			return;
+		auto typedReceiverPtr = dynamic_cast<ReceiverT *>(receiverPtr);
+		if (!typedReceiverPtr)
+			throw Error(EINVAL, "Receiver type is not dispatched");
+		add(typedPtr, typedReceiverPtr, priority);
+	}
+	virtual void clear() noexcept override
+	{
+		_receivers.clear();
+		_genericReceivers.clear();
+	}
+	virtual void modifier(Signal *, unsigned int *) noexcept override
+	{
+	}
+	/** @brief Dispatch a signal to its receivers, without virtual calls.
+	 *  @param signal The signal to dispatch.
+	 *  @param mods Active modifier flags.
+	 *  @return true if dispatch was blocked, false if allowed through.
+	 */
+	inline bool dispatch(SignalT &signal, unsigned int mods)
+	{
+		auto generic = _genericReceivers.cbegin();
+		const auto genericEnd = _genericReceivers.cend();
+		if (_receivers.empty()) {
+			for (; generic != genericEnd; ++generic) {
+				if (generic->receiverPtr->receiveSignal(signal,
+									mods))
+					return true;
+			}
+			return false;
+		}
+		const size_t key = signal.SignalT::dispatchKey();
+		auto specific = std::lower_bound(
+			_receivers.cbegin(), _receivers.cend(), key,
+			[](const Entry &entry, size_t value) {
+				return entry.key < value;
+			});
+		const auto specificEnd = _receivers.cend();
+		for (;;) {
+			const bool specificFlag =
+				specific != specificEnd && specific->key == key;
+			if (!specificFlag && generic == genericEnd)
+				return false;
+			const Entry &entry =
+				specificFlag && (generic == genericEnd ||
+						 specific->precedes(*generic))
+					? *specific++
+					: *generic++;
+			if (entry.receiverPtr->receiveSignal(signal, mods))
+				return true;
+		}
+	}
+	virtual bool dispatch(Signal *signalPtr, unsigned int mods) override
+	{
+		auto typedPtr = dynamic_cast<SignalT *>(signalPtr);
+		return typedPtr && dispatch(*typedPtr, mods);
+	}
+	virtual void remove(IReceive *removeReceiverPtr) override
+	{
+		auto matches = [removeReceiverPtr](const Entry &entry) {
+			return entry.receiverPtr == removeReceiverPtr;
+		};
+		_receivers.erase(std::remove_if(_receivers.begin(),
+						_receivers.end(), matches),
+				 _receivers.end());
+		_genericReceivers.erase(
+			std::remove_if(_genericReceivers.begin(),
+				       _genericReceivers.end(), matches),
+			_genericReceivers.end());
+	}
+	virtual bool remove(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		auto typedReceiverPtr = dynamic_cast<ReceiverT *>(receiverPtr);
+		if (!typedReceiverPtr)
+			return true;
+		if (!signalPtr) {
+			erase(_genericReceivers, 0, typedReceiverPtr);
+		} else if (auto typedPtr = dynamic_cast<SignalT *>(signalPtr)) {
+			erase(_receivers, typedPtr->SignalT::dispatchKey(),
+			      typedReceiverPtr);
+		}
+		return true;
+	}
+	virtual void trim() noexcept override
+	{
+		_receivers.shrink_to_fit();
+		_genericReceivers.shrink_to_fit();
+	}
+	virtual mcr_index_t count() const noexcept override
+	{
+		return static_cast<mcr_index_t>(_receivers.size() +
+						_genericReceivers.size());
+	}
+
+    private:
+	struct Entry {
+		size_t key;
+		ReceiverT *receiverPtr;
+		int priority;
+		uint64_t sequence;
+
+		/*! Dispatch order of receivers with the same key */
+		inline bool precedes(const Entry &other) const noexcept
+		{
+			return priority != other.priority
+				       ? priority > other.priority
+				       : sequence < other.sequence;
+		}
+		/*! Sorted by key, then dispatch order */
+		static inline bool before(const Entry &lhs,
+					  const Entry &rhs) noexcept
+		{
+			return lhs.key != rhs.key ? lhs.key < rhs.key
+						  : lhs.precedes(rhs);
+		}
+	};
+
+	/*! Receivers of one signal key, sorted by @ref Entry::before */
+	std::vector<Entry> _receivers;
+	/*! Receivers of all signals, sorted by @ref Entry::before */
+	std::vector<Entry> _genericReceivers;
+	uint64_t _sequence = 0;
+
+	static void erase(std::vector<Entry> &list, size_t key,
+			  const ReceiverT *receiverPtr)
+	{
+		for (auto iter = list.begin(); iter != list.end(); ++iter) {
+			if (iter->key == key && iter->receiverPtr == receiverPtr) {
+				list.erase(iter);
+				return;
+			}
+		}
+	}
+};
+}
+
+#endif
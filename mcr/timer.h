@@ -0,0 +1,59 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref ITimer - Act after a delay, on one shared thread
+ */
+
+#pragma once
+
+#include "mcr/trigger.h"
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mcr
+{
+/**
+ * @brief Act after a delay, with one thread for all timeouts.
+ *
+ *  Timeouts are ordered by deadline and acted in order on the timer
+ *  thread, which is started by the first timeout.  Any number of
+ *  pending timeouts costs no more threads.  Actors must return quickly,
+ *  they delay every timeout after them.
+ */
+class MCR_API ITimer {
+    public:
+	class MCR_API Deleter {
+	    public:
+		void operator()(ITimer *ptr) const;
+	};
+	MCR_DECL_INTERFACE(ITimer)
+
+	/** @brief Act once after a delay, on the timer thread.
+	 *  @param actorPtr Actor to act, not owned.  Must stay valid until
+	 *  it has acted or is cancelled.
+	 *  @param millis Milliseconds to wait.
+	 *  @return Timeout id, never 0.
+	 *  @throws Error(EINVAL) if actorPtr is nullptr.
+	 */
+	virtual uint64_t schedule(IActor *actorPtr, unsigned int millis) = 0;
+	/** @brief Cancel a timeout.
+	 *
+	 *  If the actor is acting on another thread, wait for it to
+	 *  return.  Cancelled from its own actor does not wait.
+	 *  @param id Timeout id, 0 and unknown ids are ignored.
+	 *  @return true if cancelled before acting.
+	 */
+	virtual bool cancel(uint64_t id) = 0;
+	/** @brief Number of timeouts waiting to act.
+	 *  @return Pending timeout count.
+	 */
+	virtual size_t pendingCount() const = 0;
+};
+}
+
+#endif
@@ -30,6 +30,8 @@ class MCR_API Action : public Trigger {
 		return "Action";
 	}
 	virtual bool receive(Signal *, unsigned int) override;
+	/*! Modifiers match the trigger mode */
+	virtual bool accepts(unsigned int mods) const override;
 };
 }
 #endif
@@ -0,0 +1,109 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref ActionSet - Evaluate each distinct @ref Action once
+ */
+
+#pragma once
+
+#include "mcr/dispatcher.h"
+#include "mcr/epoch.h"
+#include "mcr/trigger/action.h"
+#include "mcr/trigger/table.h"
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mcr
+{
+/**
+ * @brief Many @ref Action s, with identical predicates evaluated once.
+ *
+ *  Actions of the same signal type, dispatch key, modifiers and trigger
+ *  mode share one node, with a list of the actions to trigger.  The set
+ *  is one receiver of the dispatcher, and each event matches every
+ *  distinct node of its signal at once with a @ref TriggerTable, however
+ *  many actions share them.  Matched actions are triggered in the order
+ *  added, without calling their @ref Action::receive.
+ *
+ *  The set adds itself to the dispatcher of each signal, removes itself
+ *  from the signal of each group removed, and from its dispatchers when
+ *  destroyed.  Modifiers and trigger modes are read when
+ *  added, add actions again after changing them.  Receiving does not
+ *  lock or allocate, and may run while actions are added or removed.
+ *  Adding or removing publishes a copy of the set, and the replaced copy
+ *  is freed once no thread receives from it, see @ref Epoch.
+ */
+class MCR_API ActionSet : public IReceive {
+    public:
+	ActionSet() = default;
+	ActionSet(const ActionSet &) = delete;
+	/*! Removes the set from dispatchers */
+	virtual ~ActionSet() override;
+	ActionSet &operator=(const ActionSet &) = delete;
+
+	/** @brief Trigger actions of every node matching the signal.
+	 *  @return true if a triggered action blocks.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+
+	/** @brief Add an action triggered by a signal, not owned.
+	 *  @param signalPtr Signal type and dispatch key to trigger from.
+	 *  Must stay valid while the set has actions of its node.
+	 *  @param actionPtr Action to trigger.
+	 */
+	void add(Signal *signalPtr, Action *actionPtr);
+	/*! Remove an action from every node */
+	void remove(Action *actionPtr);
+	void clear();
+	/** @brief Number of distinct predicates evaluated. */
+	size_t nodeCount() const;
+	/** @brief Number of actions added. */
+	size_t actionCount() const;
+
+    private:
+	/*! Nodes of one signal type and dispatch key */
+	struct Group {
+		/*! Signal first added, to add the set to its dispatcher */
+		Signal *signalPtr = nullptr;
+		/*! One row per node */
+		TriggerTable table;
+		/*! Modifiers and trigger mode of each node */
+		std::vector<std::pair<unsigned int, unsigned int>> predicates;
+		/*! Actions of each node */
+		std::vector<std::vector<Action *>> actions;
+	};
+	/*! Copied on write, and read without locking */
+	struct Table {
+		std::map<std::string, std::unordered_map<size_t, Group>,
+			 std::less<>>
+			groups;
+		size_t nodeCount = 0;
+		size_t actionCount = 0;
+	};
+
+	mutable std::mutex _writeMutex;
+	/*! nullptr is an empty table */
+	std::atomic<const Table *> _table{nullptr};
+	/*! Replaced tables that may still be read */
+	Epoch::RetireList<Table> _retired;
+
+	/*! Publish an owned table, and retire the replaced one, _writeMutex
+	 *  must be locked */
+	void publish(const Table *tablePtr);
+	/*! Remove the set from the dispatcher of a removed group, and keep
+	 *  the groups of tablePtr, _writeMutex must be locked */
+	void removeDispatch(Signal *signalPtr, const Table *tablePtr);
+};
+}
+
+#endif
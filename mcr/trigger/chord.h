@@ -0,0 +1,91 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Chord - Trigger from keys pressed together
+ */
+
+#pragma once
+
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace mcr
+{
+class Libmacro;
+
+/**
+ * @brief Trigger when all of its keys are pressed together.
+ *
+ *  Keys are tested against the @ref KeyState of the context, one mask
+ *  compare per bitset word of the chord.  The chord triggers once when
+ *  its last key is pressed, if the first key was pressed no more than
+ *  @ref windowMillis before.  Releasing a key of the chord allows it to
+ *  trigger again.
+ *
+ *  Receives @ref Key signals.  Add it to a dispatcher for each of its
+ *  keys, or for all signals.
+ */
+class MCR_API Chord : public Trigger {
+    public:
+	/** @brief Libmacro context of the key state, or nullptr for the
+	 *  last created context. */
+	Libmacro *context = nullptr;
+	/*! Milliseconds between the first and last key pressed */
+	unsigned int windowMillis = MCR_CHORD_WINDOW_MILLIS;
+
+	/** @brief Construct a chord without keys.
+	 *  @param libmacroPtr Libmacro context (default nullptr).
+	 */
+	Chord(Libmacro *libmacroPtr = nullptr)
+		: Trigger()
+		, context(libmacroPtr)
+	{
+	}
+	Chord(const Chord &other);
+	virtual ~Chord() override = default;
+	Chord &operator=(const Chord &other);
+
+	virtual const char *name() const override
+	{
+		return "Chord";
+	}
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+
+	/** @brief Add a key to the chord.
+	 *  @param key Key code.
+	 *  @throws Error(ERANGE) if the key code has no key state, see
+	 *  @ref MCR_KEY_STATE_COUNT.
+	 */
+	void addKey(int key);
+	void removeKey(int key) noexcept;
+	void clearKeys() noexcept;
+	/** @brief Check if a key is part of the chord. */
+	bool hasKey(int key) const noexcept;
+	/** @brief Key codes of the chord, in the order added. */
+	inline const std::vector<int> &keys() const noexcept
+	{
+		return _keys;
+	}
+
+    private:
+	/*! Chord keys of one key state word */
+	struct KeyMask {
+		size_t index;
+		uint64_t bits;
+	};
+	std::vector<KeyMask> _masks;
+	std::vector<int> _keys;
+	/*! Triggered, and no key of the chord released since */
+	std::atomic<bool> _triggeredFlag{false};
+};
+}
+
+#endif
@@ -0,0 +1,225 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Gesture - Trigger from strokes of motion.
+ *  @ref GestureRecognizer - Recognize many gestures at once.
+ */
+
+#pragma once
+
+#include "mcr/dispatcher.h"
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mcr
+{
+class GestureRecognizer;
+
+/**
+ * @brief Trigger when motion strokes in the given directions, such as a
+ * swipe, a circle or a flick.
+ *
+ *  A swipe right is { EAST }, and a clockwise circle is every direction
+ *  clockwise.  A flick is a swipe with @ref maxMillis.  Strokes are
+ *  separated by a change of direction, so a gesture with the same
+ *  direction twice in a row, such as { EAST, EAST }, cannot be stroked
+ *  and is not matched.
+ *
+ *  Received alone, such as a macro trigger, a gesture is matched by a
+ *  private @ref GestureRecognizer with default settings, and strokes set
+ *  with @ref setStrokes are compiled on the next sample.  Many gestures are matched
+ *  faster by one shared recognizer, which triggers them without
+ *  receiving.  Add a gesture to a dispatcher or to a recognizer, not
+ *  both.
+ */
+class MCR_API Gesture : public Trigger {
+    public:
+	/*! Stroke direction, clockwise with y down as on screens */
+	enum Direction {
+		EAST = 0,
+		SOUTHEAST,
+		SOUTH,
+		SOUTHWEST,
+		WEST,
+		NORTHWEST,
+		NORTH,
+		NORTHEAST,
+		DIRECTION_COUNT
+	};
+
+	/*! Milliseconds from the first stroke starting to the last
+	 *  stroke, 0 for any */
+	unsigned int maxMillis = 0;
+
+	Gesture();
+	Gesture(std::initializer_list<Direction> directions);
+	/*! Copies strokes and triggering, the copy recognizes on its own */
+	Gesture(const Gesture &other);
+	virtual ~Gesture() override;
+	Gesture &operator=(const Gesture &other);
+
+	virtual const char *name() const override
+	{
+		return "Gesture";
+	}
+	/** @brief Receive motion, and trigger if it completes the gesture.
+	 *  @return true if triggered and blocking.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+
+	/** @brief Directions of strokes in order. */
+	inline const std::vector<Direction> &strokes() const noexcept
+	{
+		return _strokes;
+	}
+	/** @brief Set the directions of strokes in order.
+	 *
+	 *  The private recognizer compiles them on its next sample.  A
+	 *  shared recognizer must be invalidated,
+	 *  @ref GestureRecognizer::invalidate.
+	 */
+	void setStrokes(std::vector<Direction> directions);
+
+    private:
+	std::vector<Direction> _strokes;
+	/*! Recognizes this gesture received alone */
+	std::unique_ptr<GestureRecognizer> _recognizer;
+};
+
+/**
+ * @brief Match any number of @ref Gesture s from motion samples.
+ *
+ *  Motion is resampled into steps of @ref stepDistance, and each step is
+ *  quantized to one of 8 directions.  @ref strokeSteps steps in a new
+ *  direction are a stroke.  All gestures are compiled into one
+ *  Aho-Corasick automaton over stroke directions, and each stroke
+ *  advances it with one table lookup.  Every sample is constant work
+ *  without allocation, whatever the number of gestures.  Motion paused
+ *  longer than @ref idleMillis starts again.
+ *
+ *  Receives signals with @ref Signal::motion, such as @ref MoveCursor.
+ *  Add the recognizer to a dispatcher once for motion signals.  Gestures
+ *  added or changed are compiled on the next sample.  Motion left over
+ *  from a step counts toward the next.  Actors are triggered after the
+ *  recognizer is unlocked, up to @ref MCR_GESTURE_MATCH_COUNT without
+ *  allocating.
+ */
+class MCR_API GestureRecognizer : public IReceive {
+    public:
+	/*! Dimension of horizontal motion */
+	Dimension horizontal = MCR_X;
+	/*! Dimension of vertical motion, increasing down */
+	Dimension vertical = MCR_Y;
+	/*! Motion distance of one step */
+	unsigned int stepDistance = MCR_GESTURE_STEP;
+	/*! Steps in one direction to make a stroke */
+	unsigned int strokeSteps = MCR_GESTURE_STROKE_STEPS;
+	/*! Milliseconds without motion to start again */
+	unsigned int idleMillis = MCR_GESTURE_IDLE_MILLIS;
+
+	GestureRecognizer() = default;
+	GestureRecognizer(const GestureRecognizer &) = delete;
+	virtual ~GestureRecognizer() override = default;
+	GestureRecognizer &operator=(const GestureRecognizer &) = delete;
+
+	/** @brief Receive motion, and trigger gestures it completes.
+	 *  @return true if a triggered gesture blocks.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+	/** @brief Add one motion sample.
+	 *  @param position Position moved to or by.
+	 *  @param relativeFlag true if position is relative.
+	 *  @param timestamp Steady clock nanoseconds of the sample.
+	 *  @param signalPtr Signal to trigger with, may be nullptr.
+	 *  @param mods Modifiers to trigger with.
+	 *  @return true if a triggered gesture blocks.
+	 */
+	bool sample(const SpacePosition &position, bool relativeFlag,
+		    uint64_t timestamp, Signal *signalPtr = nullptr,
+		    unsigned int mods = 0);
+
+	/*! Add a gesture to match, not owned */
+	void add(Gesture *gesturePtr);
+	void remove(Gesture *gesturePtr);
+	void clear();
+	/*! Compile again after changing the strokes of added gestures */
+	void invalidate();
+	/*! Start again, as if no motion happened */
+	void reset();
+	/** @brief Number of automaton states, compiling if needed. */
+	size_t stateCount();
+
+	/** @brief Direction of motion, one of 8.
+	 *  @param dx Horizontal motion.
+	 *  @param dy Vertical motion, increasing down.
+	 */
+	static Gesture::Direction direction(long long dx,
+					    long long dy) noexcept;
+
+    private:
+	friend class Gesture;
+	/*! Gesture as compiled */
+	struct Pattern {
+		Gesture *gesturePtr;
+		size_t length;
+	};
+	/*! Gestures a stroke completes, triggered after unlocking */
+	struct Matched {
+		Gesture *gestures[MCR_GESTURE_MATCH_COUNT];
+		size_t count = 0;
+		/*! Only allocated if more gestures end together */
+		std::vector<Gesture *> overflow;
+	};
+
+	std::mutex _mutex;
+	std::vector<Gesture *> _gestures;
+	bool _compiledFlag = false;
+	std::vector<Pattern> _patterns;
+	/*! Next state of each state and direction */
+	std::vector<uint32_t> _transitions;
+	/*! Patterns ending at each state, _outputs[_outputStarts[state]] */
+	std::vector<uint32_t> _outputs;
+	std::vector<uint32_t> _outputStarts;
+	/*! Start times of the last strokes, for the longest pattern */
+	std::vector<uint64_t> _strokeTimes;
+	uint64_t _strokeCount = 0;
+	uint32_t _state = 0;
+
+	SpacePosition _last = NEW_mcr_SpacePosition;
+	bool _lastFlag = false;
+	uint64_t _lastTime = 0;
+	/*! Motion not yet a step */
+	long long _dx = 0, _dy = 0;
+	/*! Direction of the current run of steps, -1 if none */
+	int _run = -1;
+	unsigned int _runSteps = 0;
+	uint64_t _runTime = 0;
+	/*! Direction of the last stroke, -1 if none */
+	int _stroke = -1;
+
+	/*! _mutex must be locked */
+	void compile();
+	/*! _mutex must be locked */
+	void restart() noexcept;
+	/*! Private recognizer of one gesture, compiled again when its
+	 *  strokes are set */
+	explicit GestureRecognizer(Gesture *alonePtr);
+	/*! Add a sample, _mutex must be locked */
+	void advance(const SpacePosition &position, bool relativeFlag,
+		     uint64_t timestamp, Matched &matched);
+	/*! Add a stroke and match gestures, _mutex must be locked */
+	void stroke(int direction, uint64_t timestamp, Matched &matched);
+};
+}
+
+#endif
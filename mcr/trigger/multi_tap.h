@@ -0,0 +1,104 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref MultiTap - Trigger from a key tapped several times
+ */
+
+#pragma once
+
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstdint>
+
+namespace mcr
+{
+/**
+ * @brief Trigger when a key is tapped @ref count times, such as a double
+ * tap of Shift.
+ *
+ *  Each press within @ref windowMillis of the previous counts as a tap.
+ *  Reaching the count triggers once and starts again.  Key repeat is not
+ *  a tap.
+ *
+ *  When the window closes with fewer taps, they are forgotten, or with
+ *  @ref windowCloseFlag they trigger.  Without a timer the window close
+ *  is resolved by the next event received, of any key, or by calling
+ *  @ref resolve, such as from a timeout.  @ref resolvedTaps reports the
+ *  taps of the last trigger, so one multi-tap with a triple click count
+ *  can tell single, double and triple clicks apart.
+ *
+ *  The pressed flag, tap count and last tap time are one atomic word,
+ *  updated with one compare-exchange per event.  There are no timers and
+ *  no allocation.
+ *
+ *  Receives @ref Key signals.  Add it to a dispatcher for @ref key, or
+ *  for all signals.
+ */
+class MCR_API MultiTap : public Trigger {
+    public:
+	/*! Key code to tap */
+	int key = 0;
+	/*! Taps to trigger, from 1 to @ref MAX_COUNT */
+	unsigned int count = 2;
+	/*! Milliseconds from one tap to the next */
+	unsigned int windowMillis = MCR_MULTI_TAP_MILLIS;
+	/*! Also trigger when the window closes with fewer than @ref count
+	 *  taps */
+	bool windowCloseFlag = false;
+
+	/*! Largest @ref count */
+	static const unsigned int MAX_COUNT = 0x7F;
+
+	/** @brief Construct a multi-tap.
+	 *  @param keyCode Key code to tap.
+	 *  @param tapCount Taps to trigger.
+	 */
+	MultiTap(int keyCode = 0, unsigned int tapCount = 2)
+		: Trigger()
+		, key(keyCode)
+		, count(tapCount)
+	{
+	}
+	/*! Copies settings, without taps */
+	MultiTap(const MultiTap &other);
+	virtual ~MultiTap() override = default;
+	MultiTap &operator=(const MultiTap &other);
+
+	virtual const char *name() const override
+	{
+		return "MultiTap";
+	}
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+
+	/*! Taps counted toward @ref count */
+	unsigned int taps() const noexcept;
+	/*! Taps of the last trigger, @ref count or fewer when the window
+	 *  closed */
+	unsigned int resolvedTaps() const noexcept;
+	/** @brief Trigger for taps of a closed window.
+	 *
+	 *  Does nothing if there are no taps or the window is still open.
+	 *  Does not require @ref windowCloseFlag.
+	 *  @param signalPtr Signal resolving the window, may be nullptr.
+	 *  @param mods Active modifier flags.
+	 *  @return true if triggered and blocking.
+	 */
+	bool resolve(Signal *signalPtr = nullptr, unsigned int mods = 0);
+	/*! Forget taps */
+	void reset() noexcept;
+
+    private:
+	/*! Bit 63 pressed, bits 56 to 62 taps, and low bits the steady
+	 *  clock nanoseconds of the last tap */
+	std::atomic<uint64_t> _state{0};
+	std::atomic<unsigned int> _resolvedTaps{0};
+};
+}
+
+#endif
@@ -0,0 +1,163 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Sequence - Trigger from keys pressed in order.
+ *  @ref SequenceAutomaton - Match many sequences at once.
+ */
+
+#pragma once
+
+#include "mcr/dispatcher.h"
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+namespace mcr
+{
+/**
+ * @brief Trigger when its keys are pressed in order, such as a leader key
+ * sequence or a typed abbreviation.
+ *
+ *  Received alone, such as a macro trigger, a sequence matches its own
+ *  keys, with one step per key press.  Releases and presses of a key
+ *  already held, such as auto-repeat, are skipped.  Modifier keys of
+ *  @ref MCR_KEY_MODIFIER_DEFAULTS are ignored unless part of the sequence.  Other keys return to the start, or to the longest matched
+ *  part that is also the start of the sequence.
+ *
+ *  Many sequences are matched faster by one @ref SequenceAutomaton, which
+ *  triggers them without receiving.  Add a sequence to a dispatcher or to
+ *  an automaton, not both.
+ */
+class MCR_API Sequence : public Trigger {
+    public:
+	/*! Key codes to press in order, below @ref MCR_KEY_STATE_COUNT */
+	std::vector<int> keys;
+	/*! Milliseconds between the first and last key pressed */
+	unsigned int timeoutMillis = MCR_SEQUENCE_TIMEOUT_MILLIS;
+
+	Sequence() = default;
+	Sequence(std::initializer_list<int> keyCodes) : keys(keyCodes)
+	{
+	}
+	/*! Copies keys and triggering, the copy matches from the start. */
+	Sequence(const Sequence &other);
+	virtual ~Sequence() override = default;
+	Sequence &operator=(const Sequence &other);
+
+	virtual const char *name() const override
+	{
+		return "Sequence";
+	}
+	/** @brief Receive a key, and trigger if it ends the sequence.
+	 *  @return true if triggered and blocking.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+	/*! Return to the start, as if no key was pressed */
+	void reset();
+
+    private:
+	std::mutex _mutex;
+	/*! Keys as compiled, compiled again when keys change */
+	std::vector<int> _compiledKeys;
+	/*! Longest proper prefix that is also a suffix, of each prefix */
+	std::vector<size_t> _failures;
+	/*! Number of keys matched */
+	size_t _matchedCount = 0;
+	/*! Press times of the last keys */
+	std::vector<uint64_t> _times;
+	uint64_t _position = 0;
+	/*! Keys held, so auto-repeat is not another press */
+	std::vector<bool> _heldKeys =
+		std::vector<bool>(MCR_KEY_STATE_COUNT, false);
+
+	/*! _mutex must be locked */
+	void compile();
+};
+
+/**
+ * @brief Match any number of @ref Sequence s with one automaton.
+ *
+ *  All sequences are compiled into one Aho-Corasick automaton over the keys
+ *  they use.  Each key press advances a single state with one table
+ *  lookup, whatever the number of sequences.  A key no sequence uses
+ *  returns to the start, unless ignored such as modifier keys, see
+ *  @ref ignoreKey.  Releases and presses of a key already held are
+ *  skipped.  A sequence triggers when its
+ *  last key is pressed, if its first key was pressed within its timeout.
+ *
+ *  Add the automaton to a dispatcher once, for all signals or for every
+ *  key the sequences use.  Sequences added or changed are compiled on the
+ *  next key.  Sequences must not be added or removed by their own actors.
+ */
+class MCR_API SequenceAutomaton : public IReceive {
+    public:
+	/*! Ignores modifier keys of @ref MCR_KEY_MODIFIER_DEFAULTS */
+	SequenceAutomaton();
+	SequenceAutomaton(const SequenceAutomaton &) = delete;
+	virtual ~SequenceAutomaton() override = default;
+	SequenceAutomaton &operator=(const SequenceAutomaton &) = delete;
+
+	/** @brief Receive a key, and trigger sequences ending with it.
+	 *  @return true if a triggered sequence blocks.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+
+	/** @brief Add a sequence to match, not owned.
+	 *  @throws Error(ERANGE) if a key code is out of range.
+	 */
+	void add(Sequence *sequencePtr);
+	void remove(Sequence *sequencePtr);
+	void clear();
+	/*! Compile again after changing the keys of added sequences */
+	void invalidate();
+	/** @brief Skip a key, or stop skipping it.
+	 *  @param key Key code.
+	 *  @param ignoreFlag true to skip the key.
+	 */
+	void ignoreKey(int key, bool ignoreFlag = true);
+	/*! Return to the start, as if no key was pressed */
+	void reset();
+	/** @brief Number of automaton states, compiling if needed. */
+	size_t stateCount();
+
+    private:
+	/*! Sequence as compiled */
+	struct Pattern {
+		Sequence *sequencePtr;
+		size_t length;
+	};
+
+	std::mutex _mutex;
+	std::vector<Sequence *> _sequences;
+	bool _compiledFlag = false;
+	std::vector<Pattern> _patterns;
+	/*! Symbol of each key code, -1 if no sequence uses it */
+	std::vector<int16_t> _symbols;
+	size_t _symbolCount = 0;
+	/*! Next state of each state and symbol */
+	std::vector<uint32_t> _transitions;
+	/*! Patterns ending at each state, _outputs[_outputStarts[state]] */
+	std::vector<uint32_t> _outputs;
+	std::vector<uint32_t> _outputStarts;
+	std::vector<bool> _ignored;
+	/*! Keys held, so auto-repeat is not another press */
+	std::vector<bool> _heldKeys;
+	uint32_t _state = 0;
+	/*! Press times of the last keys, for the longest pattern */
+	std::vector<uint64_t> _times;
+	uint64_t _position = 0;
+
+	/*! _mutex must be locked */
+	void compile();
+};
+}
+
+#endif
@@ -0,0 +1,99 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref TriggerTable - Match modifiers against many trigger modes at
+ *  once.
+ */
+
+#pragma once
+
+#include "mcr/defines.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mcr
+{
+class Action;
+
+/**
+ * @brief Modifiers and trigger modes of many @ref Action s, matched all
+ * at once.
+ *
+ *  Rows are stored as parallel arrays, and matched 8 at a time with AVX2,
+ *  4 at a time with SSE2, or one at a time without either.  Each row
+ *  matches the same as @ref mcr_TriggerMode_match_inl.
+ */
+class MCR_API TriggerTable {
+    public:
+	/** @brief Add a row.
+	 *  @param modifiers @ref mcr_ModFlags to match.
+	 *  @param triggerMode @ref mcr_TriggerMode
+	 *  @return Row index, and bit index of @ref match
+	 */
+	size_t add(unsigned int modifiers, unsigned int triggerMode);
+	/** @brief Add the modifiers and trigger mode of an action.
+	 *  @return Row index, and bit index of @ref match
+	 */
+	size_t add(const Action &action);
+	/** @brief Change a row.
+	 *  @throws Error(ERANGE) if index is out of range.
+	 */
+	void set(size_t index, unsigned int modifiers, unsigned int triggerMode);
+	void clear() noexcept;
+	/** @brief Number of rows. */
+	inline size_t size() const noexcept
+	{
+		return _size;
+	}
+	/** @brief Number of 64-bit words written by @ref match. */
+	inline size_t wordCount() const noexcept
+	{
+		return (_size + 63) / 64;
+	}
+	/** @brief Match every row against intercepted modifiers.
+	 *  @param mods Intercepted modifier flags.
+	 *  @param bitsOut @ref wordCount words, bit i % 64 of word i / 64 is
+	 *  set if row i matches.
+	 */
+	void match(unsigned int mods, uint64_t *bitsOut) const noexcept;
+	/** @brief Match the rows of some words, to match a large table in
+	 *  chunks.
+	 *  @param mods Intercepted modifier flags.
+	 *  @param bitsOut count words, bit i % 64 of word i / 64 - firstWord
+	 *  is set if row i matches.
+	 *  @param firstWord First word, rows from firstWord * 64.
+	 *  @param count Number of words, firstWord + count must not be more
+	 *  than @ref wordCount.
+	 */
+	void match(unsigned int mods, uint64_t *bitsOut, size_t firstWord,
+		   size_t count) const noexcept;
+
+    private:
+	/*! Modifiers of each row, padded to a multiple of 8 */
+	std::vector<uint32_t> _modifiers;
+	/*! Truth table of each row, indexed by @ref predicates */
+	std::vector<uint32_t> _truths;
+	size_t _size = 0;
+
+	/*! Truth table of a trigger mode.  Bit n is the match when the
+	 *  predicates of @ref predicates are n. */
+	static uint32_t truth(unsigned int triggerMode) noexcept;
+	/*! Bit 0 equal, bit 1 all, bit 2 none, and bit 3 exclusive */
+	static inline unsigned int predicates(uint32_t modifiers,
+					      uint32_t mods) noexcept
+	{
+		const uint32_t both = modifiers & mods;
+		return (modifiers == mods) | (both == modifiers) << 1 |
+		       (both == 0) << 2 | ((mods & ~modifiers) == 0) << 3;
+	}
+};
+}
+
+#endif
@@ -0,0 +1,115 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref TapHold - One key that taps a key or holds modifiers
+ */
+
+#pragma once
+
+#include "mcr/signal/key.h"
+#include "mcr/signal/modifier.h"
+#include "mcr/timer.h"
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include <mutex>
+
+namespace mcr
+{
+class Libmacro;
+
+/**
+ * @brief Trigger a dual-role key, tapped for one key and held for
+ * modifiers.
+ *
+ *  Pressing @ref key is blocked and the decision waits.  Releasing it
+ *  first dispatches @ref tap, which is then sent.  Holding it for
+ *  @ref holdMillis, or pressing another key while waiting, sends @ref hold
+ *  to set its modifiers, and triggers the actor.  Releasing it after sends
+ *  @ref hold again to release them.  The key that resolves hold is not
+ *  blocked.  Its receivers receive the modifiers from before, and it is
+ *  sent with the hold modifiers set.
+ *
+ *  The timeout is scheduled on the @ref ITimer of the context, so any
+ *  number of dual-role keys waiting costs no threads.  Destroy the
+ *  trigger before its context.
+ *
+ *  Receives @ref Key signals.  Add it to a dispatcher for all signals, or
+ *  for @ref key and every key that may resolve hold.
+ */
+class MCR_API TapHold : public Trigger {
+    public:
+	/** @brief Libmacro context to dispatch and time in, or nullptr for
+	 *  the last created context. */
+	Libmacro *context = nullptr;
+	/*! Key code of the dual-role key */
+	int key = 0;
+	/*! Milliseconds pressed before resolving to hold */
+	unsigned int holdMillis = MCR_TAP_HOLD_MILLIS;
+	/*! Dispatched when tapped, such as Escape with @ref MCR_BOTH */
+	Key tap;
+	/*! Modifiers set while held, apply is ignored */
+	Modifier hold;
+
+	/** @brief Construct a tap-hold without keys.
+	 *  @param libmacroPtr Libmacro context (default nullptr).
+	 */
+	TapHold(Libmacro *libmacroPtr = nullptr);
+	/*! Copies settings, not a pending decision */
+	TapHold(const TapHold &other);
+	/*! Cancels a pending timeout */
+	virtual ~TapHold() override;
+	/*! Copies settings, cancels a pending decision and releases held
+	 *  modifiers */
+	TapHold &operator=(const TapHold &other);
+
+	virtual const char *name() const override
+	{
+		return "TapHold";
+	}
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+
+	/*! @ref key is pressed and not yet resolved */
+	bool pending() const;
+	/*! @ref key resolved to hold and is not yet released */
+	bool holding() const;
+
+    private:
+	enum State { IDLE, PENDING, HOLDING };
+	/*! Timer actor resolving to hold */
+	class Timeout : public IActor {
+	    public:
+		TapHold *owner;
+		Timeout(TapHold *ownerPtr) : owner(ownerPtr)
+		{
+		}
+		virtual bool act() override;
+	};
+
+	mutable std::mutex _mutex;
+	State _state = IDLE;
+	/*! Timer of the context when scheduled */
+	ITimer *_timerPtr = nullptr;
+	/*! Scheduled timeout, kept while it resolves hold so cancelling
+	 *  waits for it */
+	uint64_t _timeoutId = 0;
+	Timeout _timeout{this};
+
+	/*! Cancel the pending timeout, _mutex must not be locked */
+	void cancelTimeout(uint64_t id);
+	/*! Send the hold modifiers and trigger */
+	void resolveHold(Signal *signalPtr, unsigned int mods);
+	/*! Dispatch a copy of tap, marked as tapped by this trigger
+	 *  @param source Source of the dual-role key */
+	void dispatchTap(size_t source);
+	/*! Send hold released */
+	void sendRelease();
+};
+}
+
+#endif
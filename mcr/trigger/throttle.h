@@ -0,0 +1,94 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+/*! @file
+ *  @brief @ref Throttle - Limit the rate of triggering
+ */
+
+#pragma once
+
+#include "mcr/trigger.h"
+#include "mcr/types.h"
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mcr
+{
+/**
+ * @brief Trigger at most @ref rate times per second, with bursts of up to
+ * @ref burst.
+ *
+ *  A lock-free token bucket.  One atomic timestamp holds the time the
+ *  bucket is full again, which is the credit spent, and each event takes
+ *  a token with one compare-exchange.  Events without a token are
+ *  dropped and counted, before they reach the receiver or actor.
+ *
+ *  Accepted events are received by @ref receiverPtr if set, such as an
+ *  @ref IMacro, or else trigger the actor.  Rapid input, like scroll
+ *  wheels and joystick axes, then never waits on the receiver.
+ */
+class MCR_API Throttle : public Trigger {
+    public:
+	/*! Receiver of accepted events, instead of the actor, not owned */
+	IReceive *receiverPtr = nullptr;
+	/*! Events per second, 0 drops all */
+	unsigned int rate = MCR_THROTTLE_RATE;
+	/*! Events accepted at once after idling, at least 1 */
+	unsigned int burst = MCR_THROTTLE_BURST;
+
+	/** @brief Construct a throttle.
+	 *  @param eventRate Events per second.
+	 *  @param eventBurst Events accepted at once.
+	 */
+	Throttle(unsigned int eventRate = MCR_THROTTLE_RATE,
+		 unsigned int eventBurst = MCR_THROTTLE_BURST)
+		: Trigger()
+		, rate(eventRate)
+		, burst(eventBurst)
+	{
+	}
+	/*! Copies settings, with a full bucket */
+	Throttle(const Throttle &other);
+	virtual ~Throttle() override = default;
+	Throttle &operator=(const Throttle &other);
+
+	virtual const char *name() const override
+	{
+		return "Throttle";
+	}
+	/** @brief Take a token, and receive or trigger.
+	 *  @return false if dropped, or else the receiver or trigger
+	 *  result.
+	 */
+	virtual bool receive(Signal *signalPtr, unsigned int mods) override;
+	/*! Forwarded to @ref receiverPtr if set */
+	virtual bool accepts(unsigned int mods) const override
+	{
+		return !receiverPtr || receiverPtr->accepts(mods);
+	}
+
+	/** @brief Take a token if one is available.
+	 *  @return false if the event is over the rate.
+	 */
+	bool take() noexcept;
+	/*! Number of events dropped over the rate */
+	inline size_t droppedCount() const noexcept
+	{
+		return _droppedCount.load(std::memory_order_relaxed);
+	}
+	/*! Fill the bucket */
+	void reset() noexcept;
+
+    private:
+	/*! Steady clock nanoseconds when the bucket is full again */
+	std::atomic<uint64_t> _fullTime{0};
+	std::atomic<size_t> _droppedCount{0};
+};
+}
+
+#endif
@@ -121,18 +121,23 @@ enum mcr_TriggerMode {
 	MCR_TM_EXCLUSIVE,
 	/*! Trigger if the input set is not identical to the expected set in any way. */
 	MCR_TM_INEQUAL,
-	// MCR_TM_EQUAL_OR_NONE,   //! <todo> To be implemented: Matches exactly OR matches nothing.
-	// MCR_TM_SOME,             //! <todo> To be implemented: Matches some flags but not all (more complex logic).
+	/*! Trigger if the input set has some or all of the specified flags, and no others. 0 modifiers never match. */
+	MCR_TM_MATCH,
 	/*! Trigger if at least one specified flag is present in the input set. */
-	MCR_TM_MATCH, // Replaced 'MCR_TM_MATCH' with a potential clearer alias/placeholder for context
-	/*! Always trigger regardless of incoming modifiers. */
 	MCR_TM_ANY,
 	/** @brief Starting index for user-defined, extension logic masks. */
 	MCR_TM_USER,
 	/*! Maximum value used for triggering modes. */
 	MCR_TM_MAX = MCR_TM_ANY,
 	/*! Total count of defined trigger mode constants. */
-	MCR_TM_COUNT = MCR_TM_USER
+	MCR_TM_COUNT = MCR_TM_USER,
+	/*! Modes added later start here, so user modes keep their values.
+	 *  User modes are @ref MCR_TM_USER up to here. */
+	MCR_TM_EXTENDED = 0x10000,
+	/*! Trigger if the input set exactly matches, or has none of the specified flags. */
+	MCR_TM_EQUAL_OR_NONE = MCR_TM_EXTENDED,
+	/*! Trigger if the input set has some but not all of the specified flags, and no others. */
+	MCR_TM_SOME
 };
 
 /**
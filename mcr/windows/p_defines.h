@@ -48,4 +48,17 @@
 //  #define MCR_INTERCEPT_WAIT_MILLIS 5000
 // #endif
 
-
+/*! Default { key code, @ref mcr_ModFlags } pairs, tracked by
+ *  @ref mcr::IDispatcher::modifier. */
+#define MCR_KEY_MODIFIER_DEFAULTS                                        \
+	{ VK_CONTROL, MCR_CTRL },                                        \
+	{ VK_LCONTROL, MCR_CTRL },                                       \
+	{ VK_RCONTROL, MCR_CTRL },                                       \
+	{ VK_SHIFT, MCR_SHIFT },                                         \
+	{ VK_LSHIFT, MCR_SHIFT },                                        \
+	{ VK_RSHIFT, MCR_SHIFT },                                        \
+	{ VK_MENU, MCR_ALT },                                            \
+	{ VK_LMENU, MCR_ALT },                                           \
+	{ VK_RMENU, MCR_ALTGR },                                         \
+	{ VK_LWIN, MCR_WIN },                                            \
+	{ VK_RWIN, MCR_WIN }
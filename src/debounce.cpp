@@ -0,0 +1,44 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/debounce.h"
+#include "mcr/key_state.h"
+#include "mcr/signal.h"
+
+namespace mcr
+{
+bool Debounce::drop(const Signal *signalPtr) noexcept
+{
+	int key;
+	mcr_ApplyValue apply;
+	const uint64_t window = _windowNanos.load(std::memory_order_relaxed);
+	if (!window || !signalPtr || !signalPtr->keyPress(&key, &apply))
+		return false;
+	const auto index = static_cast<unsigned int>(key);
+	if (index >= MCR_KEY_STATE_COUNT)
+		return false;
+	/* Taps and toggles are not chatter. */
+	if (apply != MCR_SET && apply != MCR_UNSET)
+		return false;
+	const bool pressFlag = apply == MCR_SET;
+	const uint64_t state = _states[index].load(std::memory_order_relaxed);
+	const uint64_t now = KeyState::now();
+	if (now - (state & ~uint64_t(1)) < window) {
+		_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	/* Key repeat after the window, still the same transition */
+	if (pressFlag == bool(state & 1))
+		return false;
+	_states[index].store((now & ~uint64_t(1)) | pressFlag,
+			     std::memory_order_relaxed);
+	return false;
+}
+
+void Debounce::clear() noexcept
+{
+	for (auto &state : _states)
+		state.store(0, std::memory_order_relaxed);
+}
+}
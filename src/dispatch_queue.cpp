@@ -0,0 +1,552 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/dispatch_queue.h"
+#include "mcr/error.h"
+#include "mcr/factory.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! Times the dispatch thread checks for signals before sleeping */
+#define MCR_DISPATCH_QUEUE_SPIN 0x40
+
+namespace mcr
+{
+
+/*! Bounded ring of sequenced cells.  Any thread may produce, and the
+ *  dispatch thread is the only consumer.
+ *
+ *  Each cell owns a copy of its signal, destroyed by the dispatch thread
+ *  before deciding.  A cell is released for reuse by whichever side is
+ *  last to use it.  The producer releases it after reading the decision.
+ *  The dispatch thread releases it if nobody is waiting for the decision.
+ *
+ *  Producers wait for the decision on a condition variable, notified only
+ *  while a producer is waiting.
+ */
+class DispatchQueue final : public IDispatchQueue {
+    public:
+	DispatchQueue(IDispatcher *target, size_t capacity);
+	DispatchQueue(const DispatchQueue &) = delete;
+	virtual ~DispatchQueue() override;
+	DispatchQueue &operator=(const DispatchQueue &) = delete;
+
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		_target->add(signalPtr, receiverPtr);
+	}
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr,
+			 int priority) override
+	{
+		_target->add(signalPtr, receiverPtr, priority);
+	}
+	virtual void clear() noexcept override
+	{
+		_target->clear();
+	}
+	virtual void modifier(Signal *signalPtr,
+			      unsigned int *modsPtr) noexcept override
+	{
+		_target->modifier(signalPtr, modsPtr);
+	}
+	virtual bool dispatch(Signal *signalPtr, unsigned int mods) override;
+	virtual void remove(IReceive *removeReceiverPtr) override
+	{
+		_target->remove(removeReceiverPtr);
+	}
+	virtual bool remove(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		return _target->remove(signalPtr, receiverPtr);
+	}
+	virtual void trim() noexcept override
+	{
+		_target->trim();
+	}
+	virtual mcr_index_t count() const noexcept override
+	{
+		return _target->count();
+	}
+	virtual size_t unreceivedCount() const noexcept override
+	{
+		return _target->unreceivedCount();
+	}
+	virtual size_t snapshot(DispatchRecord *recordsOut,
+				size_t count) const noexcept override
+	{
+		return _target->snapshot(recordsOut, count);
+	}
+	virtual unsigned int keyModifiers(int key) const noexcept override
+	{
+		return _target->keyModifiers(key);
+	}
+	virtual void setKeyModifiers(int key, unsigned int mods) override
+	{
+		_target->setKeyModifiers(key, mods);
+	}
+	virtual bool statsFlag() const noexcept override
+	{
+		return _target->statsFlag();
+	}
+	virtual bool cacheFlag() const noexcept override
+	{
+		return _target->cacheFlag();
+	}
+	virtual void setCacheFlag(bool flag) noexcept override
+	{
+		_target->setCacheFlag(flag);
+	}
+	virtual void setStatsFlag(bool flag) noexcept override
+	{
+		_target->setStatsFlag(flag);
+	}
+	virtual unsigned int quarantineMicros() const noexcept override
+	{
+		return _target->quarantineMicros();
+	}
+	virtual void setQuarantineMicros(unsigned int micros) override
+	{
+		_target->setQuarantineMicros(micros);
+	}
+	virtual bool receiverStats(const IReceive *receiverPtr,
+				   ReceiverStats *statsOut) const noexcept override
+	{
+		return _target->receiverStats(receiverPtr, statsOut);
+	}
+	virtual bool recordFlag() const noexcept override
+	{
+		return _target->recordFlag();
+	}
+	virtual void setRecordFlag(bool flag) noexcept override
+	{
+		_target->setRecordFlag(flag);
+	}
+
+	virtual IDispatcher *target() const noexcept override
+	{
+		return _target;
+	}
+	virtual unsigned int deadline() const noexcept override
+	{
+		return _deadline;
+	}
+	virtual void setDeadline(unsigned int micros) noexcept override
+	{
+		_deadline = micros;
+	}
+	virtual size_t capacity() const noexcept override
+	{
+		return _mask + 1;
+	}
+	virtual size_t expiredCount() const noexcept override
+	{
+		return _expiredCount;
+	}
+	virtual size_t overflowCount() const noexcept override
+	{
+		return _overflowCount;
+	}
+
+    private:
+	enum State {
+		/*! Nobody waits for the decision */
+		ASYNC = 0,
+		/*! Producer waits for the decision */
+		WAITING,
+		/*! Producer stopped waiting after the deadline */
+		ABANDONED,
+		/*! Decided, not blocked */
+		PASSED,
+		/*! Decided, blocked */
+		BLOCKED
+	};
+	struct Cell {
+		/*! Equal to position when free, position + 1 when queued */
+		std::atomic<size_t> sequence;
+		std::atomic<int> state;
+		SignalCopy signal;
+		unsigned int mods;
+		/*! The signal could not be copied, the producer dispatches it */
+		bool skipFlag;
+	};
+
+	IDispatcher *_target;
+	std::unique_ptr<Cell[]> _cells;
+	size_t _mask;
+	/*! Next position to produce */
+	std::atomic<size_t> _tail{0};
+	/*! Next position to consume, dispatch thread only */
+	size_t _head = 0;
+	std::atomic<unsigned int> _deadline{MCR_DISPATCH_DEADLINE_MICROS};
+	std::atomic<size_t> _expiredCount{0};
+	std::atomic<size_t> _overflowCount{0};
+	std::atomic<unsigned int> _waitingCount{0};
+	std::mutex _decidedMutex;
+	std::condition_variable _decided;
+	std::atomic<bool> _running{true};
+	std::atomic<bool> _sleeping{false};
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	std::thread _thread;
+
+	/*! @return Queued cell, or nullptr if full or the signal cannot be
+	 *  copied */
+	Cell *push(Signal *signalPtr, unsigned int mods, State state,
+		   size_t *positionPtr) noexcept;
+	bool wait(Cell &cell, size_t position);
+	inline void release(Cell &cell, size_t position) noexcept
+	{
+		cell.sequence.store(position + _mask + 1);
+	}
+
+	void run();
+	inline bool ready() const noexcept
+	{
+		return _cells[_head & _mask].sequence.load() == _head + 1;
+	}
+	bool dispatchNext();
+	void sleep();
+};
+
+/*! Dispatch queue for each shard of signal sources */
+class ShardedDispatcher final : public IShardedDispatcher {
+    public:
+	ShardedDispatcher(IDispatcher *target, size_t shardCount,
+			  size_t capacity);
+	ShardedDispatcher(const ShardedDispatcher &) = delete;
+	ShardedDispatcher &operator=(const ShardedDispatcher &) = delete;
+
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		_target->add(signalPtr, receiverPtr);
+	}
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr,
+			 int priority) override
+	{
+		_target->add(signalPtr, receiverPtr, priority);
+	}
+	virtual void clear() noexcept override
+	{
+		_target->clear();
+	}
+	virtual void modifier(Signal *signalPtr,
+			      unsigned int *modsPtr) noexcept override
+	{
+		_target->modifier(signalPtr, modsPtr);
+	}
+	virtual bool dispatch(Signal *signalPtr, unsigned int mods) override
+	{
+		return _shards[shardOf(signalPtr)]->dispatch(signalPtr, mods);
+	}
+	virtual void remove(IReceive *removeReceiverPtr) override
+	{
+		_target->remove(removeReceiverPtr);
+	}
+	virtual bool remove(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		return _target->remove(signalPtr, receiverPtr);
+	}
+	virtual void trim() noexcept override
+	{
+		_target->trim();
+	}
+	virtual mcr_index_t count() const noexcept override
+	{
+		return _target->count();
+	}
+	virtual size_t unreceivedCount() const noexcept override
+	{
+		return _target->unreceivedCount();
+	}
+	virtual size_t snapshot(DispatchRecord *recordsOut,
+				size_t count) const noexcept override
+	{
+		return _target->snapshot(recordsOut, count);
+	}
+	virtual unsigned int keyModifiers(int key) const noexcept override
+	{
+		return _target->keyModifiers(key);
+	}
+	virtual void setKeyModifiers(int key, unsigned int mods) override
+	{
+		_target->setKeyModifiers(key, mods);
+	}
+	virtual bool statsFlag() const noexcept override
+	{
+		return _target->statsFlag();
+	}
+	virtual bool cacheFlag() const noexcept override
+	{
+		return _target->cacheFlag();
+	}
+	virtual void setCacheFlag(bool flag) noexcept override
+	{
+		_target->setCacheFlag(flag);
+	}
+	virtual void setStatsFlag(bool flag) noexcept override
+	{
+		_target->setStatsFlag(flag);
+	}
+	virtual unsigned int quarantineMicros() const noexcept override
+	{
+		return _target->quarantineMicros();
+	}
+	virtual void setQuarantineMicros(unsigned int micros) override
+	{
+		_target->setQuarantineMicros(micros);
+	}
+	virtual bool receiverStats(const IReceive *receiverPtr,
+				   ReceiverStats *statsOut) const noexcept override
+	{
+		return _target->receiverStats(receiverPtr, statsOut);
+	}
+	virtual bool recordFlag() const noexcept override
+	{
+		return _target->recordFlag();
+	}
+	virtual void setRecordFlag(bool flag) noexcept override
+	{
+		_target->setRecordFlag(flag);
+	}
+
+	virtual IDispatcher *target() const noexcept override
+	{
+		return _target;
+	}
+	virtual size_t shardCount() const noexcept override
+	{
+		return _shards.size();
+	}
+	virtual IDispatchQueue &shard(size_t index) const override
+	{
+		if (index >= _shards.size())
+			throw Error(ERANGE, "Shard index out of range");
+		return *_shards[index];
+	}
+	virtual size_t shardOf(const Signal *signalPtr) const noexcept override
+	{
+		return signalPtr ? signalPtr->source % _shards.size() : 0;
+	}
+	virtual void setDeadline(unsigned int micros) noexcept override
+	{
+		for (auto &shardPtr : _shards)
+			shardPtr->setDeadline(micros);
+	}
+
+    private:
+	IDispatcher *_target;
+	std::vector<std::unique_ptr<IDispatchQueue, IDispatcher::Deleter>>
+		_shards;
+};
+
+namespace factory
+{
+
+std::unique_ptr<IDispatchQueue, IDispatcher::Deleter>
+createDispatchQueue(IDispatcher *target, size_t capacity)
+{
+	return std::unique_ptr<IDispatchQueue, IDispatcher::Deleter>(
+		new DispatchQueue(target, capacity));
+}
+
+std::shared_ptr<IDispatchQueue> createDispatchQueueShared(IDispatcher *target,
+							  size_t capacity)
+{
+	return createDispatchQueue(target, capacity);
+}
+
+std::unique_ptr<IShardedDispatcher, IDispatcher::Deleter>
+createShardedDispatcher(IDispatcher *target, size_t shardCount,
+			size_t capacity)
+{
+	return std::unique_ptr<IShardedDispatcher, IDispatcher::Deleter>(
+		new ShardedDispatcher(target, shardCount, capacity));
+}
+
+std::shared_ptr<IShardedDispatcher>
+createShardedDispatcherShared(IDispatcher *target, size_t shardCount,
+			      size_t capacity)
+{
+	return createShardedDispatcher(target, shardCount, capacity);
+}
+
+}
+
+DispatchQueue::DispatchQueue(IDispatcher *target, size_t capacity)
+	: _target(target)
+{
+	if (!target)
+		throw Error(EFAULT, "Null dispatch queue target");
+	size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+	_cells.reset(new Cell[size]);
+	_mask = size - 1;
+	for (size_t i = 0; i < size; i++) {
+		_cells[i].sequence.store(i);
+		_cells[i].state.store(ASYNC);
+	}
+	_thread = std::thread(&DispatchQueue::run, this);
+}
+
+DispatchQueue::~DispatchQueue()
+{
+	_running = false;
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_wake.notify_one();
+	}
+	_thread.join();
+}
+
+bool DispatchQueue::dispatch(Signal *signalPtr, unsigned int mods)
+{
+	/* Receivers dispatching again would wait for themselves. */
+	if (std::this_thread::get_id() == _thread.get_id())
+		return _target->dispatch(signalPtr, mods);
+	const bool waitFlag = _deadline != 0;
+	size_t position;
+	Cell *cell = push(signalPtr, mods, waitFlag ? WAITING : ASYNC,
+			  &position);
+	if (_sleeping) {
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_wake.notify_one();
+	}
+	if (!cell) {
+		++_overflowCount;
+		return _target->dispatch(signalPtr, mods);
+	}
+	return waitFlag && wait(*cell, position);
+}
+
+DispatchQueue::Cell *DispatchQueue::push(Signal *signalPtr,
+					  unsigned int mods, State state,
+					  size_t *positionPtr) noexcept
+{
+	size_t position = _tail.load(std::memory_order_relaxed);
+	Cell *cell;
+	for (;;) {
+		cell = &_cells[position & _mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::ptrdiff_t>(sequence - position);
+		if (diff == 0) {
+			if (_tail.compare_exchange_weak(
+				    position, position + 1,
+				    std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return nullptr;
+		} else {
+			position = _tail.load(std::memory_order_relaxed);
+		}
+	}
+	/* The cell is claimed, so it is queued even if not copied. */
+	cell->skipFlag = !cell->signal.assign(signalPtr);
+	cell->mods = mods;
+	cell->state.store(cell->skipFlag ? ASYNC : state,
+			  std::memory_order_relaxed);
+	cell->sequence.store(position + 1);
+	if (cell->skipFlag)
+		return nullptr;
+	*positionPtr = position;
+	return cell;
+}
+
+bool DispatchQueue::wait(Cell &cell, size_t position)
+{
+	const auto until = std::chrono::steady_clock::now() +
+			   std::chrono::microseconds(_deadline);
+	int state = cell.state.load();
+	auto decided = [&cell, &state]() {
+		state = cell.state.load();
+		return state == PASSED || state == BLOCKED;
+	};
+	if (!decided()) {
+		std::unique_lock<std::mutex> lock(_decidedMutex);
+		++_waitingCount;
+		_decided.wait_until(lock, until, decided);
+		--_waitingCount;
+	}
+	if (state == WAITING &&
+	    cell.state.compare_exchange_strong(state, ABANDONED)) {
+		++_expiredCount;
+		return false;
+	}
+	/* Decided, possibly while the deadline expired */
+	release(cell, position);
+	return state == BLOCKED;
+}
+
+void DispatchQueue::run()
+{
+	for (;;) {
+		if (dispatchNext())
+			continue;
+		if (!_running)
+			break;
+		sleep();
+	}
+}
+
+bool DispatchQueue::dispatchNext()
+{
+	if (!ready())
+		return false;
+	const size_t position = _head++;
+	Cell &cell = _cells[position & _mask];
+	bool blocked = false;
+	if (!cell.skipFlag) {
+		try {
+			blocked = _target->dispatch(cell.signal.get(), cell.mods);
+		} catch (...) {
+		}
+	}
+	cell.signal.reset();
+	int expected = WAITING;
+	if (!cell.state.compare_exchange_strong(expected,
+						blocked ? BLOCKED : PASSED)) {
+		release(cell, position);
+	} else if (_waitingCount.load()) {
+		/* Locking orders the decision before a producer sleeps. */
+		{
+			std::lock_guard<std::mutex> lock(_decidedMutex);
+		}
+		_decided.notify_all();
+	}
+	return true;
+}
+
+void DispatchQueue::sleep()
+{
+	for (int i = 0; i < MCR_DISPATCH_QUEUE_SPIN; i++) {
+		if (ready() || !_running)
+			return;
+		std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(_sleepMutex);
+	_sleeping = true;
+	_wake.wait(lock, [this]() { return ready() || !_running; });
+	_sleeping = false;
+}
+
+ShardedDispatcher::ShardedDispatcher(IDispatcher *target, size_t shardCount,
+				     size_t capacity)
+	: _target(target)
+{
+	if (!target)
+		throw Error(EFAULT, "Null sharded dispatcher target");
+	if (!shardCount)
+		shardCount = std::thread::hardware_concurrency();
+	if (!shardCount)
+		shardCount = 1;
+	_shards.reserve(shardCount);
+	for (size_t i = 0; i < shardCount; i++)
+		_shards.push_back(factory::createDispatchQueue(target, capacity));
+}
+}
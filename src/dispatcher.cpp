@@ -3,38 +3,437 @@
   SPDX-License-Identifier: LGPL-2.1-only */
 
 #include "mcr/dispatcher.h"
+#include "mcr/epoch.h"
+#include "mcr/error.h"
 #include "mcr/factory.h"
+#include "mcr/signal.h"
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <initializer_list>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*! Bits in the dispatch key interest filter, a power of 2 */
+#define MCR_DISPATCH_INTEREST_BITS 0x1000
 
 namespace mcr
 {
 
-/*! Generic dispatcher type for any signal type. Will always dispatch to every
- *  receiver. */
+/*! Generic dispatcher type for any signal type.
+ *
+ *  Receivers are indexed by signal type name, then by
+ *  @ref Signal::dispatchKey.  Receivers added without a signal receive
+ *  everything.  Dispatch only visits receivers of the dispatched signal.
+ *
+ *  The receiver index is read-copy-update.  Dispatch reads an immutable
+ *  table without locking.  Writers copy the table, modify the copy, and
+ *  publish it.  Replaced tables are freed by epoch, once every dispatch
+ *  that may have loaded them has returned.
+ *
+ *  Each table has a bit filter of dispatch keys with receivers, mirrored
+ *  outside of the table.  Most signals have no receiver, and are passed
+ *  through after testing one bit, before reading the table.
+ *
+ *  While recording, every dispatch is recorded into a fixed ring of
+ *  sequence-locked slots.  Writers never wait, and a snapshot skips slots
+ *  being overwritten.
+ *
+ *  Modifiers are tracked from keys with a dense table of key code to
+ *  modifier flags, seeded with @ref MCR_KEY_MODIFIER_DEFAULTS.
+ *
+ *  Dispatches may be cached.  A direct-mapped, sequence-locked cache maps
+ *  (signal, modifiers) to the receivers accepting them.  Adding or
+ *  removing receivers increments the cache generation, so a cached
+ *  dispatch is only used with the table it was resolved from.
+ *
+ *  Receivers may be timed.  A timed receiver slower than the quarantine
+ *  budget is moved to the quarantine lane, a thread that receives without
+ *  blocking.
+ */
 class MCR_API Dispatcher final : public IDispatcher {
     public:
 	Libmacro *context = nullptr;
 
 	Dispatcher(Libmacro *context = nullptr);
 	Dispatcher(const Dispatcher &other);
-	virtual ~Dispatcher() = default;
+	virtual ~Dispatcher();
 	Dispatcher &operator=(const Dispatcher &other);
 
-	virtual void add(Signal *signalPtr, IReceive *receiverPtr) override;
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr) override
+	{
+		add(signalPtr, receiverPtr, 0);
+	}
+	virtual void add(Signal *signalPtr, IReceive *receiverPtr,
+			 int priority) override;
 	virtual void clear() noexcept override;
 	virtual bool dispatch(Signal *, unsigned int) final override;
-	virtual void modifier(Signal *, unsigned int *) noexcept override {}
+	virtual unsigned int dispatchBatch(Signal *const *signals, size_t n,
+					   unsigned int mods,
+					   bool *blockedOut) final override;
+	virtual void modifier(Signal *signalPtr,
+			      unsigned int *modsPtr) noexcept override;
 	virtual void remove(IReceive *removeReceiverPtr) override;
-	virtual void trim() noexcept override
+	virtual bool remove(Signal *signalPtr, IReceive *receiverPtr) override;
+	virtual void trim() noexcept override;
+	virtual mcr_index_t count() const noexcept override;
+	virtual size_t unreceivedCount() const noexcept override
 	{
+		return _unreceivedCount.load(std::memory_order_relaxed);
+	}
+	virtual size_t snapshot(DispatchRecord *recordsOut,
+				size_t count) const noexcept override;
+	virtual unsigned int keyModifiers(int key) const noexcept override
+	{
+		const auto index = static_cast<unsigned int>(key);
+		return index < MCR_KEY_MODIFIER_COUNT ?
+			       _keyModifiers[index].load(
+				       std::memory_order_relaxed) :
+			       0;
+	}
+	virtual void setKeyModifiers(int key, unsigned int mods) override;
+	virtual bool statsFlag() const noexcept override
+	{
+		return _statsFlag.load(std::memory_order_relaxed);
+	}
+	virtual void setStatsFlag(bool flag) noexcept override
+	{
+		_statsFlag = flag;
+	}
+	virtual bool cacheFlag() const noexcept override
+	{
+		return _cacheFlag.load(std::memory_order_relaxed);
+	}
+	virtual void setCacheFlag(bool flag) noexcept override
+	{
+		_cacheFlag = flag;
+	}
+	virtual unsigned int quarantineMicros() const noexcept override
+	{
+		return _quarantineMicros.load(std::memory_order_relaxed);
+	}
+	virtual void setQuarantineMicros(unsigned int micros) override;
+	virtual bool receiverStats(const IReceive *receiverPtr,
+				   ReceiverStats *statsOut) const noexcept override;
+	virtual bool recordFlag() const noexcept override
+	{
+		return _recordFlag.load(std::memory_order_relaxed);
+	}
+	virtual void setRecordFlag(bool flag) noexcept override
+	{
+		_recordFlag = flag;
 	}
-	virtual mcr_index_t count() const noexcept override;
 
     private:
-	std::unordered_set<IReceive *> _receivers;
+	/*! One receiver, shared by all of its entries and tables.
+	 *
+	 *  Entries are tagged with the generation they were added in.
+	 *  Removing a receiver increments the generation, so dispatch skips
+	 *  its entries at once, even in tables still being read. */
+	struct Slot {
+		std::atomic<uint32_t> generation{0};
+		/*! Live entries in the newest table, written by writers only */
+		std::atomic<mcr_index_t> entryCount{0};
+		std::atomic<uint64_t> callCount{0};
+		std::atomic<uint64_t> blockCount{0};
+		std::atomic<uint64_t> totalNanos{0};
+		std::atomic<uint64_t> maxNanos{0};
+		std::atomic<bool> quarantinedFlag{false};
+
+		void account(uint64_t nanos, bool blocked) noexcept;
+	};
+	class Lane;
+
+	/*! Receivers are sorted by priority, then by the order added. */
+	struct Entry {
+		IReceive *receiverPtr;
+		int priority;
+		uint64_t sequence;
+		/*! Owned by @ref Table::slots */
+		Slot *slotPtr;
+		uint32_t generation;
+
+		inline bool before(const Entry &other) const
+		{
+			if (priority != other.priority)
+				return priority > other.priority;
+			return sequence < other.sequence;
+		}
+		inline bool live() const noexcept
+		{
+			return slotPtr->generation.load(
+				       std::memory_order_acquire) == generation;
+		}
+	};
+	/*! Contiguous and sorted, dispatch walks in order */
+	typedef std::vector<Entry> ReceiverList;
+	/*! Receivers of one signal type, by dispatch key */
+	typedef std::unordered_map<size_t, ReceiverList> KeyMap;
+
+	/*! Immutable once published */
+	struct Table {
+		/*! Receivers of all signals */
+		ReceiverList genericReceivers;
+		/*! Transparent comparison to find type names without
+		 *  allocating */
+		std::map<std::string, KeyMap, std::less<>> typeReceivers;
+		/*! Shared between tables, freed with the last table reading
+		 *  them */
+		std::unordered_map<const IReceive *, std::shared_ptr<Slot>>
+			slots;
+		mcr_index_t count = 0;
+		/*! Order of adding, to break priority ties */
+		uint64_t sequence = 0;
+		/*! Set for every dispatch key with receivers.  Keys share bits,
+		 *  so a set bit may still have no receivers. */
+		uint64_t interest[MCR_DISPATCH_INTEREST_BITS / 64] = {};
+
+		static inline size_t interestBit(size_t key) noexcept
+		{
+			/* Small keys, such as key codes, never share bits. */
+			uint64_t bits = key;
+			bits ^= bits >> 32;
+			bits ^= bits >> 12;
+			return bits & (MCR_DISPATCH_INTEREST_BITS - 1);
+		}
+		inline bool interested(size_t key) const noexcept
+		{
+			size_t bit = interestBit(key);
+			return interest[bit / 64] & (uint64_t(1) << (bit % 64));
+		}
+		/*! Rebuild interest from receivers */
+		void index() noexcept;
+		/*! Erase entries and slots of removed receivers */
+		void compact();
+		const ReceiverList *find(Signal *signalPtr, size_t key) const;
+	};
+
+	/*! Flight recorder slot, fields are atomic to be read while
+	 *  written. */
+	struct RecordSlot {
+		/*! 2 * position + 1 while writing, 2 * position + 2 after */
+		std::atomic<uint64_t> sequence{0};
+		std::atomic<const char *> signalName{nullptr};
+		std::atomic<size_t> key{0};
+		std::atomic<unsigned int> mods{0};
+		std::atomic<IReceive *> blockingReceiverPtr{nullptr};
+		std::atomic<uint64_t> timestamp{0};
+		std::atomic<uint64_t> duration{0};
+	};
+
+	/*! Receivers of one (signal, modifiers) dispatch, in dispatch
+	 *  order */
+	struct Resolved {
+		unsigned int count = 0;
+		const Entry *entries[MCR_DISPATCH_CACHE_RECEIVERS];
+	};
+	/*! Cached dispatch, fields are atomic to be read while written. */
+	struct CacheSlot {
+		/*! Odd while writing */
+		std::atomic<uint64_t> sequence{0};
+		/*! Table the entries belong to, with its cache generation */
+		std::atomic<const Table *> tablePtr{nullptr};
+		std::atomic<uint64_t> generation{0};
+		std::atomic<const char *> signalName{nullptr};
+		std::atomic<size_t> key{0};
+		std::atomic<unsigned int> mods{0};
+		std::atomic<unsigned int> count{0};
+		std::atomic<const Entry *> entries[MCR_DISPATCH_CACHE_RECEIVERS];
+	};
+
+	/*! Marks a dispatch reading the published table.  Only the
+	 *  reading thread writes, see @ref Epoch. */
+	class ReadGuard {
+	    public:
+		ReadGuard()
+		{
+			++dispatchDepth;
+		}
+		~ReadGuard()
+		{
+			--dispatchDepth;
+		}
+
+	    private:
+		Epoch::Guard _epoch;
+	};
+
+	/*! Dispatchers being read by this thread, to defer compacting while
+	 *  receivers remove receivers */
+	static thread_local unsigned int dispatchDepth;
+
+	/*! nullptr is an empty table */
+	std::atomic<const Table *> _table{nullptr};
+	/*! Interest of the published table, written after publishing */
+	std::atomic<uint64_t> _interest[MCR_DISPATCH_INTEREST_BITS / 64];
+	/*! The published table has generic receivers */
+	std::atomic<bool> _genericFlag{false};
+	/*! Writers are serialized, readers are not */
+	std::mutex _writeMutex;
+	/*! Replaced tables that may still be read, marked with the lane
+	 *  position they wait for */
+	Epoch::RetireList<Table> _retired;
+	/*! Entries removed but not yet compacted */
+	std::atomic<mcr_index_t> _deadCount{0};
+	std::atomic<size_t> _unreceivedCount{0};
+	/*! Next flight recorder position */
+	std::atomic<uint64_t> _recordPosition{0};
+	RecordSlot _records[MCR_DISPATCH_RECORD_COUNT];
+	std::atomic<bool> _recordFlag{false};
+	std::atomic<bool> _statsFlag{false};
+	std::atomic<bool> _cacheFlag{false};
+	/*! Incremented whenever receivers are added or removed */
+	std::atomic<uint64_t> _cacheGeneration{0};
+	CacheSlot _cache[MCR_DISPATCH_CACHE_SIZE];
+	std::atomic<unsigned int> _quarantineMicros{0};
+	/*! Modifier flags of each key code */
+	std::atomic<unsigned int> _keyModifiers[MCR_KEY_MODIFIER_COUNT];
+	/*! Created with the first quarantine budget, then never replaced */
+	std::atomic<Lane *> _lane{nullptr};
+
+	/*! Copy the current table without removed receivers, modify with
+	 *  updateFn, and publish. */
+	template <typename UpdateFn> void update(UpdateFn updateFn);
+	/*! Publish a new table, _writeMutex must be locked. */
+	void publish(const Table *tablePtr) noexcept;
+	/*! Free replaced tables if not read, _writeMutex must be locked. */
+	void reclaim() noexcept;
+	/*! Insert sorted, or move an existing receiver to a new priority.
+	 *  @return true if the receiver was not already in the list */
+	static bool insert(ReceiverList &list, const Entry &entry);
+	static mcr_index_t erase(ReceiverList &list, IReceive *receiverPtr);
+	/*! Skip entries of a receiver in tables being read,
+	 *  _writeMutex must be locked. */
+	void kill(Slot &slot) noexcept;
+	/*! Check the interest mirror, without reading the table */
+	inline bool interested(const Signal *signalPtr,
+			       size_t key) const noexcept
+	{
+		if (_genericFlag.load(std::memory_order_acquire))
+			return true;
+		if (!signalPtr)
+			return false;
+		const size_t bit = Table::interestBit(key);
+		return _interest[bit / 64].load(std::memory_order_acquire) &
+		       (uint64_t(1) << (bit % 64));
+	}
+	/*! Count and record a dispatch nobody receives */
+	void unreceived(Signal *signalPtr, size_t key, unsigned int mods) noexcept;
+	/*! Dispatch to receivers of a table and record it, tablePtr may be
+	 *  nullptr. */
+	bool dispatchTable(const Table *tablePtr, Signal *signalPtr,
+			   size_t key, unsigned int mods);
+	/*! @return Receiver that blocked, or nullptr */
+	IReceive *receiveTable(const Table *tablePtr, Signal *signalPtr,
+			       size_t key, unsigned int mods);
+	/*! Receivers accepting mods from the cache, or resolve and cache
+	 *  them.
+	 *  @return false if there are too many receivers to cache */
+	bool resolve(const Table *tablePtr, const ReceiverList *specific,
+		     Signal *signalPtr, size_t key, unsigned int mods,
+		     Resolved *resolvedOut);
+	static inline size_t cacheIndex(const char *signalName, size_t key,
+					unsigned int mods) noexcept
+	{
+		uint64_t bits = (key * 0x9E3779B97F4A7C15ull) ^
+				reinterpret_cast<uintptr_t>(signalName) ^
+				(uint64_t(mods) << 20);
+		bits ^= bits >> 29;
+		return bits & (MCR_DISPATCH_CACHE_SIZE - 1);
+	}
+	/*! Merge specific and generic receivers in priority order.
+	 *  @return Receiver that blocked, or nullptr */
+	IReceive *dispatchLists(const ReceiverList *specific,
+				const ReceiverList &generic, Signal *signalPtr,
+				unsigned int mods);
+	/*! Receive one signal, timed or quarantined.
+	 *  @return true if blocked */
+	bool receive(const Entry &entry, Signal *signalPtr, unsigned int mods);
+	void record(Signal *signalPtr, size_t key, unsigned int mods,
+		    IReceive *blockingReceiverPtr, uint64_t timestamp) noexcept;
+	static inline uint64_t now() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			       std::chrono::steady_clock::now()
+				       .time_since_epoch())
+			.count();
+	}
 };
 
+/*! Thread that quarantined receivers receive on.
+ *
+ *  Tasks are a bounded ring of sequenced cells, like
+ *  @ref IDispatchQueue.  Any thread may push without locking, and the lane
+ *  thread is the only consumer.  Each cell owns a copy of its signal.
+ *
+ *  Cells keep the entry they were pushed for, and entries removed
+ *  before their turn are skipped.  Removing never waits on the lane, so
+ *  a slot stays alive until the lane passes every cell pushed while its
+ *  table was read, see @ref Dispatcher::reclaim. */
+class Dispatcher::Lane {
+    public:
+	Lane();
+	Lane(const Lane &) = delete;
+	~Lane();
+	Lane &operator=(const Lane &) = delete;
+
+	/*! @return false if full, or the signal cannot be copied */
+	bool push(const Entry &entry, Signal *signalPtr, unsigned int mods);
+	/*! @return Next position to push */
+	inline size_t pushed() const noexcept
+	{
+		return _tail.load();
+	}
+	/*! @return true if every position before this one is received or
+	 *  skipped */
+	inline bool passed(size_t position) const noexcept
+	{
+		return _done.load() >= position;
+	}
+
+    private:
+	struct Cell {
+		/*! Equal to position when free, position + 1 when queued */
+		std::atomic<size_t> sequence;
+		/*! Receiver is nullptr if the signal was not copied */
+		Entry entry;
+		SignalCopy signal;
+		unsigned int mods;
+	};
+
+	Cell _cells[MCR_DISPATCH_QUEUE_SIZE];
+	/*! Next position to push */
+	std::atomic<size_t> _tail{0};
+	/*! Positions received or skipped */
+	std::atomic<size_t> _done{0};
+	std::atomic<bool> _sleeping{false};
+	std::atomic<bool> _running{true};
+	/*! Locks sleeping */
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::thread _thread;
+
+	inline bool ready() const noexcept
+	{
+		const size_t position = _done.load(std::memory_order_relaxed);
+		return _cells[position % MCR_DISPATCH_QUEUE_SIZE].sequence.load() ==
+		       position + 1;
+	}
+	void run();
+	void sleep();
+};
+
+thread_local unsigned int Dispatcher::dispatchDepth = 0;
+
 void IDispatcher::Deleter::operator()(IDispatcher *ptr) const
 {
 	delete ptr;
@@ -64,11 +463,33 @@ Dispatcher::Dispatcher(Libmacro *libmacroPtr)
 	: IDispatcher()
 	, context(libmacroPtr)
 {
+	struct KeyModifier {
+		int key;
+		unsigned int mods;
+	};
+	for (auto &keyMods : _keyModifiers)
+		keyMods.store(0, std::memory_order_relaxed);
+	for (auto &bits : _interest)
+		bits.store(0, std::memory_order_relaxed);
+	for (auto &pair :
+	     std::initializer_list<KeyModifier>{ MCR_KEY_MODIFIER_DEFAULTS })
+		setKeyModifiers(pair.key, pair.mods);
 }
 
 Dispatcher::Dispatcher(const Dispatcher &other)
 	: context(other.context)
 {
+	for (auto &bits : _interest)
+		bits.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < MCR_KEY_MODIFIER_COUNT; i++)
+		_keyModifiers[i].store(other._keyModifiers[i].load(),
+				       std::memory_order_relaxed);
+}
+
+Dispatcher::~Dispatcher()
+{
+	delete _lane.load();
+	delete _table.load();
 }
 
 Dispatcher &Dispatcher::operator=(const Dispatcher &other)
@@ -76,42 +497,662 @@ Dispatcher &Dispatcher::operator=(const Dispatcher &other)
 	if (&other == this)
 		return *this;
 	context = other.context;
+	for (size_t i = 0; i < MCR_KEY_MODIFIER_COUNT; i++)
+		_keyModifiers[i].store(other._keyModifiers[i].load(),
+				       std::memory_order_relaxed);
 	return *this;
 }
 
-void Dispatcher::add(Signal *, IReceive *receiverPtr)
+void Dispatcher::add(Signal *signalPtr, IReceive *receiverPtr, int priority)
 {
-	_receivers.insert(receiverPtr);
+	if (!receiverPtr)
+		return;
+	update([signalPtr, receiverPtr, priority](Table &table) {
+		ReceiverList *list = &table.genericReceivers;
+		if (signalPtr) {
+			auto &keyMap = table.typeReceivers[signalPtr->name()];
+			list = &keyMap[signalPtr->dispatchKey()];
+		}
+		auto &slot = table.slots[receiverPtr];
+		if (!slot)
+			slot = std::make_shared<Slot>();
+		if (insert(*list,
+			   Entry{ receiverPtr, priority, table.sequence++,
+				  slot.get(), slot->generation.load() })) {
+			++slot->entryCount;
+			++table.count;
+		}
+	});
 }
 
 void Dispatcher::clear() noexcept
 {
-	_receivers.clear();
+	std::unique_lock<std::mutex> lock(_writeMutex);
+	if (const Table *tablePtr = _table.load()) {
+		for (auto &slotIter : tablePtr->slots)
+			kill(*slotIter.second);
+	}
+	publish(nullptr);
+	_deadCount = 0;
+	reclaim();
 }
 
 bool Dispatcher::dispatch(Signal *signalPtr, unsigned int mods)
 {
-	bool blockFlag = false;
-	for (auto iter : _receivers) {
-		if (!iter)
-			continue;
-		if (iter->receive(signalPtr, mods)) {
-			blockFlag = true;
-			break;
+	const size_t key = signalPtr ? signalPtr->dispatchKey() : 0;
+	if (!interested(signalPtr, key)) {
+		unreceived(signalPtr, key, mods);
+		return false;
+	}
+	ReadGuard guard;
+	return dispatchTable(_table.load(), signalPtr, key, mods);
+}
+
+unsigned int Dispatcher::dispatchBatch(Signal *const *signals, size_t n,
+				       unsigned int mods, bool *blockedOut)
+{
+	/* One snapshot for the whole frame */
+	ReadGuard guard;
+	const Table *tablePtr = _table.load();
+	for (size_t i = 0; i < n; i++) {
+		Signal *signalPtr = signals[i];
+		bool blocked = false;
+		if (signalPtr) {
+			blocked = dispatchTable(tablePtr, signalPtr,
+						signalPtr->dispatchKey(), mods);
+			if (!blocked)
+				Dispatcher::modifier(signalPtr, &mods);
 		}
+		if (blockedOut)
+			blockedOut[i] = blocked;
 	}
-	return blockFlag;
+	return mods;
+}
+
+void Dispatcher::modifier(Signal *signalPtr, unsigned int *modsPtr) noexcept
+{
+	int key;
+	mcr_ApplyValue apply;
+	if (!signalPtr || !signalPtr->keyPress(&key, &apply))
+		return;
+	const unsigned int flags = keyModifiers(key);
+	/* All-ones masks select set, unset and toggle without branching. */
+	const unsigned int setMask = 0u - (apply == MCR_SET);
+	const unsigned int unsetMask =
+		0u - (apply == MCR_UNSET || apply == MCR_BOTH);
+	const unsigned int toggleMask = 0u - (apply == MCR_TOGGLE);
+	*modsPtr = ((*modsPtr | (flags & setMask)) & ~(flags & unsetMask)) ^
+		   (flags & toggleMask);
+}
+
+void Dispatcher::setKeyModifiers(int key, unsigned int mods)
+{
+	const auto index = static_cast<unsigned int>(key);
+	if (index >= MCR_KEY_MODIFIER_COUNT)
+		throw Error(ERANGE, "Key code out of modifier range");
+	_keyModifiers[index].store(mods, std::memory_order_relaxed);
 }
 
 void Dispatcher::remove(IReceive *removeReceiverPtr)
 {
 	if (!removeReceiverPtr)
 		return;
-	_receivers.erase(removeReceiverPtr);
+	{
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		const Table *tablePtr = _table.load();
+		if (!tablePtr)
+			return;
+		auto found = tablePtr->slots.find(removeReceiverPtr);
+		if (found == tablePtr->slots.end())
+			return;
+		/* Waiting signals of the lane are skipped, not waited for. */
+		kill(*found->second);
+	}
+	/* Receivers removing receivers leave compacting to trim(). */
+	if (!dispatchDepth)
+		update([](Table &) {});
+}
+
+bool Dispatcher::remove(Signal *signalPtr, IReceive *receiverPtr)
+{
+	if (!receiverPtr)
+		return true;
+	/* Other entries stay live, so dispatch reading the replaced table
+	 * may still receive this one, as when adding. */
+	update([signalPtr, receiverPtr](Table &table) {
+		auto slotIter = table.slots.find(receiverPtr);
+		if (slotIter == table.slots.end())
+			return;
+		if (!signalPtr) {
+			if (!erase(table.genericReceivers, receiverPtr))
+				return;
+		} else {
+			auto typeIter =
+				table.typeReceivers.find(signalPtr->name());
+			if (typeIter == table.typeReceivers.end())
+				return;
+			auto &keyMap = typeIter->second;
+			auto keyIter = keyMap.find(signalPtr->dispatchKey());
+			if (keyIter == keyMap.end() ||
+			    !erase(keyIter->second, receiverPtr))
+				return;
+			if (keyIter->second.empty())
+				keyMap.erase(keyIter);
+			if (keyMap.empty())
+				table.typeReceivers.erase(typeIter);
+		}
+		--table.count;
+		if (!--slotIter->second->entryCount)
+			table.slots.erase(slotIter);
+	});
+	return true;
+}
+
+void Dispatcher::trim() noexcept
+{
+	if (_deadCount.load() && !dispatchDepth) {
+		try {
+			update([](Table &) {});
+			return;
+		} catch (...) {
+		}
+	}
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	reclaim();
 }
 
 mcr_index_t Dispatcher::count() const noexcept
 {
-	return _receivers.size();
+	ReadGuard guard;
+	const Table *tablePtr = _table.load();
+	const mcr_index_t dead = _deadCount.load();
+	return tablePtr && tablePtr->count > dead ? tablePtr->count - dead : 0;
+}
+
+void Dispatcher::kill(Slot &slot) noexcept
+{
+	if (!slot.entryCount)
+		return;
+	slot.generation.fetch_add(1, std::memory_order_release);
+	_cacheGeneration.fetch_add(1, std::memory_order_release);
+	_deadCount += slot.entryCount;
+	slot.entryCount = 0;
+}
+
+void Dispatcher::Table::compact()
+{
+	auto dead = [](const Entry &entry) { return !entry.live(); };
+	auto compactList = [this, &dead](ReceiverList &list) {
+		auto end = std::remove_if(list.begin(), list.end(), dead);
+		count -= static_cast<mcr_index_t>(list.end() - end);
+		list.erase(end, list.end());
+	};
+	compactList(genericReceivers);
+	for (auto typeIter = typeReceivers.begin();
+	     typeIter != typeReceivers.end();) {
+		auto &keyMap = typeIter->second;
+		for (auto keyIter = keyMap.begin(); keyIter != keyMap.end();) {
+			compactList(keyIter->second);
+			if (keyIter->second.empty())
+				keyIter = keyMap.erase(keyIter);
+			else
+				++keyIter;
+		}
+		if (keyMap.empty())
+			typeIter = typeReceivers.erase(typeIter);
+		else
+			++typeIter;
+	}
+	for (auto slotIter = slots.begin(); slotIter != slots.end();) {
+		if (slotIter->second->entryCount)
+			++slotIter;
+		else
+			slotIter = slots.erase(slotIter);
+	}
+}
+
+void Dispatcher::Table::index() noexcept
+{
+	std::fill(std::begin(interest), std::end(interest), 0);
+	for (auto &typeIter : typeReceivers) {
+		for (auto &keyIter : typeIter.second) {
+			size_t bit = interestBit(keyIter.first);
+			interest[bit / 64] |= uint64_t(1) << (bit % 64);
+		}
+	}
+}
+
+const Dispatcher::ReceiverList *
+Dispatcher::Table::find(Signal *signalPtr, size_t key) const
+{
+	auto typeIter = typeReceivers.find(signalPtr->name());
+	if (typeIter == typeReceivers.end())
+		return nullptr;
+	auto keyIter = typeIter->second.find(key);
+	if (keyIter == typeIter->second.end())
+		return nullptr;
+	return &keyIter->second;
+}
+
+template <typename UpdateFn> void Dispatcher::update(UpdateFn updateFn)
+{
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	/* Only writers replace the table, so it cannot be freed here. */
+	const Table *current = _table.load();
+	std::unique_ptr<Table> next(current ? new Table(*current) :
+					      new Table());
+	if (_deadCount.load())
+		next->compact();
+	updateFn(*next);
+	next->index();
+	_retired.reserve();
+	publish(next.release());
+	_deadCount = 0;
+	reclaim();
+}
+
+void Dispatcher::publish(const Table *tablePtr) noexcept
+{
+	const Table *prev = _table.exchange(tablePtr);
+	for (size_t i = 0; i < MCR_DISPATCH_INTEREST_BITS / 64; i++)
+		_interest[i].store(tablePtr ? tablePtr->interest[i] : 0,
+				   std::memory_order_release);
+	_genericFlag.store(tablePtr && !tablePtr->genericReceivers.empty(),
+			   std::memory_order_release);
+	/* Cached entries of a freed table must never match a new table
+	 * allocated at the same address. */
+	_cacheGeneration.fetch_add(1, std::memory_order_release);
+	/* clear() may not be able to retire, leak rather than free in use */
+	_retired.retire(prev);
+}
+
+void Dispatcher::reclaim() noexcept
+{
+	Lane *lanePtr = _lane.load();
+	_retired.reclaim([lanePtr](size_t &lanePosition) {
+		if (!lanePtr)
+			return false;
+		/* Once quiescent, every push reading the table is done, and
+		 * its cells may still point to its slots. */
+		if (lanePosition == SIZE_MAX)
+			lanePosition = lanePtr->pushed();
+		return !lanePtr->passed(lanePosition);
+	});
+}
+
+bool Dispatcher::insert(ReceiverList &list, const Entry &entry)
+{
+	bool inserted = !erase(list, entry.receiverPtr);
+	auto pos = std::upper_bound(list.begin(), list.end(), entry,
+				    [](const Entry &lhs, const Entry &rhs) {
+					    return lhs.before(rhs);
+				    });
+	list.insert(pos, entry);
+	return inserted;
+}
+
+mcr_index_t Dispatcher::erase(ReceiverList &list, IReceive *receiverPtr)
+{
+	auto found = std::find_if(list.begin(), list.end(),
+				  [receiverPtr](const Entry &entry) {
+					  return entry.receiverPtr ==
+						 receiverPtr;
+				  });
+	if (found == list.end())
+		return 0;
+	list.erase(found);
+	return 1;
+}
+
+void Dispatcher::unreceived(Signal *signalPtr, size_t key,
+			    unsigned int mods) noexcept
+{
+	_unreceivedCount.fetch_add(1, std::memory_order_relaxed);
+	if (_recordFlag.load(std::memory_order_relaxed))
+		record(signalPtr, key, mods, nullptr, now());
+}
+
+bool Dispatcher::dispatchTable(const Table *tablePtr, Signal *signalPtr,
+			       size_t key, unsigned int mods)
+{
+	if (!_recordFlag.load(std::memory_order_relaxed))
+		return receiveTable(tablePtr, signalPtr, key, mods);
+	const uint64_t timestamp = now();
+	IReceive *blockingReceiverPtr =
+		receiveTable(tablePtr, signalPtr, key, mods);
+	record(signalPtr, key, mods, blockingReceiverPtr, timestamp);
+	return blockingReceiverPtr;
+}
+
+IReceive *Dispatcher::receiveTable(const Table *tablePtr, Signal *signalPtr,
+				   size_t key, unsigned int mods)
+{
+	const ReceiverList *specific = nullptr;
+	if (!tablePtr) {
+		_unreceivedCount.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	if (signalPtr && tablePtr->interested(key))
+		specific = tablePtr->find(signalPtr, key);
+	if (!specific && tablePtr->genericReceivers.empty()) {
+		_unreceivedCount.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	if (signalPtr && _cacheFlag.load(std::memory_order_relaxed)) {
+		Resolved resolved;
+		if (resolve(tablePtr, specific, signalPtr, key, mods,
+			    &resolved)) {
+			for (unsigned int i = 0; i < resolved.count; i++) {
+				const Entry &entry = *resolved.entries[i];
+				if (entry.live() &&
+				    receive(entry, signalPtr, mods))
+					return entry.receiverPtr;
+			}
+			return nullptr;
+		}
+	}
+	return dispatchLists(specific, tablePtr->genericReceivers, signalPtr,
+			     mods);
+}
+
+bool Dispatcher::resolve(const Table *tablePtr, const ReceiverList *specific,
+			 Signal *signalPtr, size_t key, unsigned int mods,
+			 Resolved *resolvedOut)
+{
+	const char *signalName = signalPtr->name();
+	CacheSlot &slot = _cache[cacheIndex(signalName, key, mods)];
+	const uint64_t generation =
+		_cacheGeneration.load(std::memory_order_acquire);
+	uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+	if (!(sequence & 1) &&
+	    slot.tablePtr.load(std::memory_order_relaxed) == tablePtr &&
+	    slot.generation.load(std::memory_order_relaxed) == generation &&
+	    slot.signalName.load(std::memory_order_relaxed) == signalName &&
+	    slot.key.load(std::memory_order_relaxed) == key &&
+	    slot.mods.load(std::memory_order_relaxed) == mods) {
+		const unsigned int count =
+			slot.count.load(std::memory_order_relaxed);
+		for (unsigned int i = 0; i < count; i++)
+			resolvedOut->entries[i] =
+				slot.entries[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+			resolvedOut->count = count;
+			return true;
+		}
+	}
+
+	/* Miss, merge in priority order like dispatchLists */
+	const Entry *lhs = nullptr, *lhsEnd = nullptr;
+	const Entry *rhs = tablePtr->genericReceivers.data();
+	const Entry *rhsEnd = rhs + tablePtr->genericReceivers.size();
+	if (specific) {
+		lhs = specific->data();
+		lhsEnd = lhs + specific->size();
+	}
+	unsigned int count = 0;
+	while (lhs != lhsEnd || rhs != rhsEnd) {
+		const Entry *next;
+		if (rhs == rhsEnd || (lhs != lhsEnd && lhs->before(*rhs)))
+			next = lhs++;
+		else
+			next = rhs++;
+		if (!next->live() || !next->receiverPtr->accepts(mods))
+			continue;
+		if (count == MCR_DISPATCH_CACHE_RECEIVERS)
+			return false;
+		resolvedOut->entries[count++] = next;
+	}
+	resolvedOut->count = count;
+
+	/* Another writer has this slot, leave it uncached. */
+	sequence = slot.sequence.load(std::memory_order_relaxed);
+	if ((sequence & 1) || !slot.sequence.compare_exchange_strong(
+				      sequence, sequence + 1,
+				      std::memory_order_relaxed))
+		return true;
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.tablePtr.store(tablePtr, std::memory_order_relaxed);
+	slot.generation.store(generation, std::memory_order_relaxed);
+	slot.signalName.store(signalName, std::memory_order_relaxed);
+	slot.key.store(key, std::memory_order_relaxed);
+	slot.mods.store(mods, std::memory_order_relaxed);
+	slot.count.store(count, std::memory_order_relaxed);
+	for (unsigned int i = 0; i < count; i++)
+		slot.entries[i].store(resolvedOut->entries[i],
+				      std::memory_order_relaxed);
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	return true;
+}
+
+IReceive *Dispatcher::dispatchLists(const ReceiverList *specific,
+				    const ReceiverList &generic,
+				    Signal *signalPtr, unsigned int mods)
+{
+	const Entry *lhs = nullptr, *lhsEnd = nullptr;
+	const Entry *rhs = generic.data(), *rhsEnd = rhs + generic.size();
+	if (specific) {
+		lhs = specific->data();
+		lhsEnd = lhs + specific->size();
+	}
+	while (lhs != lhsEnd || rhs != rhsEnd) {
+		const Entry *next;
+		if (rhs == rhsEnd || (lhs != lhsEnd && lhs->before(*rhs)))
+			next = lhs++;
+		else
+			next = rhs++;
+		if (next->live() && receive(*next, signalPtr, mods))
+			return next->receiverPtr;
+	}
+	return nullptr;
+}
+
+void Dispatcher::record(Signal *signalPtr, size_t key, unsigned int mods,
+			IReceive *blockingReceiverPtr,
+			uint64_t timestamp) noexcept
+{
+	const uint64_t position =
+		_recordPosition.fetch_add(1, std::memory_order_relaxed);
+	RecordSlot &slot = _records[position & (MCR_DISPATCH_RECORD_COUNT - 1)];
+	slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.signalName.store(signalPtr ? signalPtr->name() : nullptr,
+			      std::memory_order_relaxed);
+	slot.key.store(key, std::memory_order_relaxed);
+	slot.mods.store(mods, std::memory_order_relaxed);
+	slot.blockingReceiverPtr.store(blockingReceiverPtr,
+				       std::memory_order_relaxed);
+	slot.timestamp.store(timestamp, std::memory_order_relaxed);
+	slot.duration.store(now() - timestamp, std::memory_order_relaxed);
+	slot.sequence.store(2 * position + 2, std::memory_order_release);
+}
+
+size_t Dispatcher::snapshot(DispatchRecord *recordsOut,
+			    size_t count) const noexcept
+{
+	if (!recordsOut)
+		return 0;
+	const uint64_t end = _recordPosition.load(std::memory_order_acquire);
+	uint64_t position = end > MCR_DISPATCH_RECORD_COUNT ?
+				    end - MCR_DISPATCH_RECORD_COUNT :
+				    0;
+	if (end - position > count)
+		position = end - count;
+	size_t copied = 0;
+	for (; position < end; position++) {
+		const RecordSlot &slot =
+			_records[position & (MCR_DISPATCH_RECORD_COUNT - 1)];
+		const uint64_t sequence =
+			slot.sequence.load(std::memory_order_acquire);
+		/* Still writing, or already overwritten */
+		if (sequence != 2 * position + 2)
+			continue;
+		DispatchRecord record{
+			slot.signalName.load(std::memory_order_relaxed),
+			slot.key.load(std::memory_order_relaxed),
+			slot.mods.load(std::memory_order_relaxed),
+			slot.blockingReceiverPtr.load(
+				std::memory_order_relaxed),
+			slot.timestamp.load(std::memory_order_relaxed),
+			slot.duration.load(std::memory_order_relaxed)
+		};
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+		recordsOut[copied++] = record;
+	}
+	return copied;
+}
+void Dispatcher::setQuarantineMicros(unsigned int micros)
+{
+	if (micros && !_lane.load()) {
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		if (!_lane.load())
+			_lane = new Lane();
+	}
+	_quarantineMicros = micros;
+}
+
+bool Dispatcher::receiverStats(const IReceive *receiverPtr,
+			       ReceiverStats *statsOut) const noexcept
+{
+	ReadGuard guard;
+	const Table *tablePtr = _table.load();
+	if (!tablePtr || !statsOut)
+		return false;
+	auto found = tablePtr->slots.find(receiverPtr);
+	if (found == tablePtr->slots.end() || !found->second->entryCount)
+		return false;
+	const Slot &stats = *found->second;
+	*statsOut = ReceiverStats{
+		stats.callCount.load(std::memory_order_relaxed),
+		stats.blockCount.load(std::memory_order_relaxed),
+		stats.totalNanos.load(std::memory_order_relaxed),
+		stats.maxNanos.load(std::memory_order_relaxed),
+		stats.quarantinedFlag.load(std::memory_order_relaxed)
+	};
+	return true;
+}
+
+bool Dispatcher::receive(const Entry &entry, Signal *signalPtr,
+			 unsigned int mods)
+{
+	Slot &stats = *entry.slotPtr;
+	if (stats.quarantinedFlag.load(std::memory_order_relaxed)) {
+		/* A full lane receives here, still without blocking. */
+		Lane *lanePtr = _lane.load();
+		if (!lanePtr ||
+		    !lanePtr->push(entry, signalPtr, mods))
+			entry.receiverPtr->receive(signalPtr, mods);
+		return false;
+	}
+	if (!_statsFlag.load(std::memory_order_relaxed))
+		return entry.receiverPtr->receive(signalPtr, mods);
+	const uint64_t timestamp = now();
+	const bool blocked = entry.receiverPtr->receive(signalPtr, mods);
+	const uint64_t nanos = now() - timestamp;
+	stats.account(nanos, blocked);
+	const uint64_t budget =
+		_quarantineMicros.load(std::memory_order_relaxed);
+	if (budget && nanos > budget * 1000)
+		stats.quarantinedFlag.store(true, std::memory_order_relaxed);
+	return blocked;
+}
+
+void Dispatcher::Slot::account(uint64_t nanos, bool blocked) noexcept
+{
+	callCount.fetch_add(1, std::memory_order_relaxed);
+	if (blocked)
+		blockCount.fetch_add(1, std::memory_order_relaxed);
+	totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+	uint64_t max = maxNanos.load(std::memory_order_relaxed);
+	while (nanos > max && !maxNanos.compare_exchange_weak(
+				      max, nanos, std::memory_order_relaxed))
+		;
+}
+
+Dispatcher::Lane::Lane()
+{
+	for (size_t i = 0; i < MCR_DISPATCH_QUEUE_SIZE; i++)
+		_cells[i].sequence.store(i, std::memory_order_relaxed);
+	_thread = std::thread(&Lane::run, this);
+}
+
+Dispatcher::Lane::~Lane()
+{
+	_running = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wake.notify_one();
+	}
+	_thread.join();
+}
+
+bool Dispatcher::Lane::push(const Entry &entry, Signal *signalPtr,
+			    unsigned int mods)
+{
+	size_t position = _tail.load(std::memory_order_relaxed);
+	Cell *cell;
+	for (;;) {
+		cell = &_cells[position % MCR_DISPATCH_QUEUE_SIZE];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::ptrdiff_t>(sequence - position);
+		if (diff == 0) {
+			if (_tail.compare_exchange_weak(
+				    position, position + 1,
+				    std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return false;
+		} else {
+			position = _tail.load(std::memory_order_relaxed);
+		}
+	}
+	/* The cell is claimed, so it is queued even if not copied. */
+	const bool copied = cell->signal.assign(signalPtr);
+	cell->entry = entry;
+	if (!copied)
+		cell->entry.receiverPtr = nullptr;
+	cell->mods = mods;
+	cell->sequence.store(position + 1);
+	if (_sleeping) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wake.notify_one();
+	}
+	return copied;
+}
+
+void Dispatcher::Lane::run()
+{
+	for (;;) {
+		if (!ready()) {
+			if (!_running)
+				return;
+			sleep();
+			continue;
+		}
+		const size_t position = _done.load(std::memory_order_relaxed);
+		Cell &cell = _cells[position % MCR_DISPATCH_QUEUE_SIZE];
+		/* Removed receivers are skipped, their slot is kept until
+		 * the lane passes this position. */
+		if (cell.entry.receiverPtr && cell.entry.live()) {
+			try {
+				cell.entry.receiverPtr->receive(
+					cell.signal.get(), cell.mods);
+			} catch (...) {
+			}
+		}
+		cell.signal.reset();
+		cell.sequence.store(position + MCR_DISPATCH_QUEUE_SIZE);
+		_done.store(position + 1);
+	}
+}
+
+void Dispatcher::Lane::sleep()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_sleeping = true;
+	_wake.wait(lock, [this]() { return ready() || !_running; });
+	_sleeping = false;
 }
 }
@@ -0,0 +1,106 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/epoch.h"
+
+#include <atomic>
+
+namespace mcr
+{
+namespace
+{
+/*! Epoch of one reading thread, 0 while not reading.  Records are never
+ *  freed, a thread exiting releases its record to the next new thread. */
+struct Record {
+	std::atomic<uint64_t> epoch{0};
+	std::atomic<bool> inUse{true};
+	Record *next = nullptr;
+};
+
+/*! Starts at 1, 0 is not reading */
+std::atomic<uint64_t> globalEpoch{1};
+/*! Push-only list of all records */
+std::atomic<Record *> records{nullptr};
+/*! Set if a reader has no record, nothing is quiescent after */
+std::atomic<bool> pinned{false};
+
+Record *acquire()
+{
+	for (Record *recordPtr = records.load(std::memory_order_acquire);
+	     recordPtr; recordPtr = recordPtr->next) {
+		bool inUse = false;
+		if (!recordPtr->inUse.load(std::memory_order_relaxed) &&
+		    recordPtr->inUse.compare_exchange_strong(
+			    inUse, true, std::memory_order_acquire))
+			return recordPtr;
+	}
+	Record *recordPtr = new Record();
+	recordPtr->next = records.load(std::memory_order_relaxed);
+	while (!records.compare_exchange_weak(recordPtr->next, recordPtr,
+					      std::memory_order_release,
+					      std::memory_order_relaxed))
+		;
+	return recordPtr;
+}
+
+struct Local {
+	Record *recordPtr = nullptr;
+	unsigned int depth = 0;
+
+	~Local()
+	{
+		if (recordPtr) {
+			recordPtr->epoch.store(0, std::memory_order_release);
+			recordPtr->inUse.store(false, std::memory_order_release);
+		}
+	}
+};
+
+thread_local Local local;
+}
+
+void Epoch::enter() noexcept
+{
+	if (local.depth++)
+		return;
+	if (!local.recordPtr) {
+		try {
+			local.recordPtr = acquire();
+		} catch (...) {
+			/* Without a record, leak rather than free in use */
+			pinned.store(true);
+			return;
+		}
+	}
+	/* Ordered before the reader loads any published pointer */
+	local.recordPtr->epoch.store(globalEpoch.load());
+}
+
+void Epoch::leave() noexcept
+{
+	if (--local.depth || !local.recordPtr)
+		return;
+	local.recordPtr->epoch.store(0, std::memory_order_release);
+}
+
+uint64_t Epoch::retire() noexcept
+{
+	/* Readers that loaded the replaced pointer entered at this epoch or
+	 * earlier.  Readers entering later load the replacement. */
+	return globalEpoch.fetch_add(1);
+}
+
+bool Epoch::quiescent(uint64_t tag) noexcept
+{
+	if (pinned.load())
+		return false;
+	for (Record *recordPtr = records.load(std::memory_order_acquire);
+	     recordPtr; recordPtr = recordPtr->next) {
+		const uint64_t epoch = recordPtr->epoch.load();
+		if (epoch && epoch <= tag)
+			return false;
+	}
+	return true;
+}
+}
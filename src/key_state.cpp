@@ -0,0 +1,71 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/key_state.h"
+#include "mcr/signal.h"
+
+#include <chrono>
+
+namespace mcr
+{
+void KeyState::set(int key, bool pressedFlag, uint64_t timestamp) noexcept
+{
+	const auto index = static_cast<unsigned int>(key);
+	if (index >= MCR_KEY_STATE_COUNT)
+		return;
+	const uint64_t bit = uint64_t(1) << (index % 64);
+	if (pressedFlag) {
+		/* Key repeat is not a new press. */
+		if (_words[index / 64].load(std::memory_order_relaxed) & bit)
+			return;
+		/* Press time first, so a pressed key never has an old one. */
+		_pressTimes[index].store(timestamp, std::memory_order_relaxed);
+		_words[index / 64].fetch_or(bit, std::memory_order_release);
+	} else {
+		_words[index / 64].fetch_and(~bit, std::memory_order_release);
+	}
+}
+
+bool KeyState::press(const Signal *signalPtr) noexcept
+{
+	int key;
+	mcr_ApplyValue apply;
+	if (!signalPtr || !signalPtr->keyPress(&key, &apply))
+		return false;
+	switch (apply) {
+	case MCR_SET:
+	case MCR_BOTH:
+		set(key, true, now());
+		break;
+	case MCR_UNSET:
+		set(key, false, 0);
+		break;
+	case MCR_TOGGLE:
+		set(key, !pressed(key), now());
+		break;
+	}
+	return true;
+}
+
+void KeyState::release(const Signal *signalPtr) noexcept
+{
+	int key;
+	mcr_ApplyValue apply;
+	if (signalPtr && signalPtr->keyPress(&key, &apply) && apply == MCR_BOTH)
+		set(key, false, 0);
+}
+
+void KeyState::clear() noexcept
+{
+	for (auto &word : _words)
+		word.store(0, std::memory_order_release);
+}
+
+uint64_t KeyState::now() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+}
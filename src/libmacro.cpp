@@ -5,7 +5,15 @@
 #include "mcr/libmacro.h"
 #include "mcr/error.h"
 #include "mcr/factory.h"
-
+#include "mcr/signal.h"
+#include "mcr/trigger/chord.h"
+#include "mcr/trigger/gesture.h"
+#include "mcr/trigger/multi_tap.h"
+#include "mcr/trigger/sequence.h"
+#include "mcr/trigger/tap_hold.h"
+#include "mcr/trigger/throttle.h"
+
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -45,6 +53,19 @@ class MCR_API LibmacroImpl final : public Libmacro {
 
 	virtual IDispatcher *genericDispatcher() const override;
 	virtual void setGenericDispatcher(IDispatcher *value) override;
+	virtual bool dispatch(Signal *signalPtr) final override;
+	virtual unsigned int dispatchDepthMax() const override
+	{
+		return _dispatchDepthMax;
+	}
+	virtual void setDispatchDepthMax(unsigned int depth) override
+	{
+		_dispatchDepthMax = depth;
+	}
+	virtual size_t droppedDispatchCount() const override
+	{
+		return _droppedDispatchCount;
+	}
 
 	virtual ISerial &serial() override;
 	virtual const ISerial &serial() const override;
@@ -55,6 +76,26 @@ class MCR_API LibmacroImpl final : public Libmacro {
 	virtual const ISignalRegistry &signalRegistry() const override;
 	virtual ITriggerRegistry &triggerRegistry() override;
 	virtual const ITriggerRegistry &triggerRegistry() const override;
+	virtual KeyState &keyState() override
+	{
+		return _keyState;
+	}
+	virtual const KeyState &keyState() const override
+	{
+		return _keyState;
+	}
+	virtual Debounce &debounce() override
+	{
+		return _debounce;
+	}
+	virtual const Debounce &debounce() const override
+	{
+		return _debounce;
+	}
+	virtual ITimer &timer() override
+	{
+		return *_timer;
+	}
 
 	virtual bool enabled() const override;
 	virtual void setEnabled(bool val) override;
@@ -63,7 +104,9 @@ class MCR_API LibmacroImpl final : public Libmacro {
 	bool _enabled = false;
 	bool _blockableFlag = false;
 	bool _genericDispatchFlag = false;
-	unsigned int _modifiers = 0;
+	std::atomic<unsigned int> _modifiers{0};
+	std::atomic<unsigned int> _dispatchDepthMax{MCR_DISPATCH_DEPTH_MAX};
+	std::atomic<size_t> _droppedDispatchCount{0};
 	std::unique_ptr<ISerial, ISerial::Deleter> _serial;
 	std::unique_ptr<IMacroRegistry, IMacroRegistry::Deleter> _macroRegistry;
 	std::unique_ptr<ISignalRegistry, ISignalRegistry::Deleter>
@@ -73,8 +116,39 @@ class MCR_API LibmacroImpl final : public Libmacro {
 	std::unique_ptr<IDispatcher, IDispatcher::Deleter>
 		_genericDispatcherInstancePt;
 	IDispatcher *_genericDispatcherPtr;
+
+	Debounce _debounce{0};
+	KeyState _keyState;
+	/*! Last member, timeouts stop before anything they use is destroyed */
+	std::unique_ptr<ITimer, ITimer::Deleter> _timer;
+
+	/*! Dispatch one signal through the pipeline, not queued */
+	bool dispatchPipeline(Signal *signalPtr);
+	/*! Dispatch to receivers and update modifiers.
+	 *  @return true if blocked */
+	bool dispatchReceivers(Signal *signalPtr);
 };
 
+/*! Copy of a signal dispatched from inside dispatch, waiting on a work
+ *  list */
+struct DispatchWork {
+	LibmacroImpl *contextPtr;
+	SignalCopy signal;
+	/*! 1 if dispatched by receivers of the outermost signal */
+	unsigned int depth;
+};
+/*! Work list of one thread.  Nested dispatches are queued instead of
+ *  recursing, and drained by the outermost dispatch. */
+struct DispatchWorkList {
+	/*! Reserved to @ref MCR_DISPATCH_WORK_MAX, so work being dispatched
+	 *  is never moved */
+	std::vector<DispatchWork> pending;
+	/*! Depth of the signal dispatching now */
+	unsigned int depth = 0;
+	bool activeFlag = false;
+};
+static thread_local DispatchWorkList threadDispatchWork;
+
 void Libmacro::Deleter::operator()(Libmacro *ptr) const
 {
 	delete ptr;
@@ -104,7 +178,14 @@ LibmacroImpl::LibmacroImpl(bool enabled)
 	, _genericDispatcherInstancePt(
 		  internal::factory::createGenericDispatcher(this))
 	, _genericDispatcherPtr(&*_genericDispatcherInstancePt)
+	, _timer(factory::createTimer())
 {
+	_triggerRegistry->map<Chord>();
+	_triggerRegistry->map<Gesture>();
+	_triggerRegistry->map<MultiTap>();
+	_triggerRegistry->map<Sequence>();
+	_triggerRegistry->map<TapHold>();
+	_triggerRegistry->map<Throttle>();
 	{
 		std::lock_guard<std::mutex> lock(_registryMutex);
 		_registryStack.push_back(this);
@@ -191,6 +272,102 @@ void LibmacroImpl::setGenericDispatcher(IDispatcher *value)
 	_genericDispatcherPtr = value;
 }
 
+bool LibmacroImpl::dispatch(Signal *signalPtr)
+{
+	if (!signalPtr)
+		return false;
+	DispatchWorkList &work = threadDispatchWork;
+	if (work.activeFlag) {
+		const unsigned int depth = work.depth + 1;
+		if (depth > _dispatchDepthMax ||
+		    work.pending.size() >= MCR_DISPATCH_WORK_MAX) {
+			++_droppedDispatchCount;
+			return false;
+		}
+		work.pending.push_back(DispatchWork{this, SignalCopy(), depth});
+		if (work.pending.back().signal.assign(signalPtr))
+			return false;
+		/* Cannot be copied, dispatch now, still bounded by depth */
+		work.pending.pop_back();
+		struct Nest {
+			DispatchWorkList &work;
+			const unsigned int outerDepth;
+			~Nest()
+			{
+				work.depth = outerDepth;
+			}
+		} nest{work, work.depth};
+		work.depth = depth;
+		return dispatchPipeline(signalPtr);
+	}
+	/* Reset the work list even if a receiver throws. */
+	struct Drain {
+		DispatchWorkList &work;
+		~Drain()
+		{
+			work.pending.clear();
+			work.depth = 0;
+			work.activeFlag = false;
+		}
+	} drain{work};
+	if (work.pending.capacity() < MCR_DISPATCH_WORK_MAX)
+		work.pending.reserve(MCR_DISPATCH_WORK_MAX);
+	work.activeFlag = true;
+	bool blocked = dispatchPipeline(signalPtr);
+	/* Grows while draining, index instead of iterating */
+	for (size_t i = 0; i < work.pending.size(); i++) {
+		DispatchWork &next = work.pending[i];
+		work.depth = next.depth;
+		next.contextPtr->dispatchPipeline(next.signal.get());
+		next.signal.reset();
+	}
+	return blocked;
+}
+
+bool LibmacroImpl::dispatchPipeline(Signal *signalPtr)
+{
+	if (signalPtr->dispatchFlag) {
+		/* Chatter never changes the key state. */
+		if (_debounce.drop(signalPtr))
+			return true;
+		/* Receivers see dispatched keys already pressed, blocked or
+		 * not. */
+		const bool keyFlag = _keyState.press(signalPtr);
+		const bool blocked = dispatchReceivers(signalPtr);
+		if (keyFlag)
+			_keyState.release(signalPtr);
+		if (blocked)
+			return true;
+	}
+	signalPtr->send();
+	return false;
+}
+
+bool LibmacroImpl::dispatchReceivers(Signal *signalPtr)
+{
+	unsigned int mods = _modifiers;
+	IDispatcher *dispatcher = signalPtr->dispatcherPtr;
+	IDispatcher *generic = nullptr;
+	if (_genericDispatchFlag && _genericDispatcherPtr != dispatcher)
+		generic = _genericDispatcherPtr;
+	if (dispatcher && dispatcher->dispatch(signalPtr, mods))
+		return true;
+	if (generic && generic->dispatch(signalPtr, mods))
+		return true;
+	if (!dispatcher)
+		dispatcher = generic;
+	if (dispatcher) {
+		/* Merge into modifiers changed by other dispatch threads. */
+		unsigned int previous = _modifiers.load();
+		do {
+			mods = previous;
+			dispatcher->modifier(signalPtr, &mods);
+		} while (mods != previous &&
+			 !_modifiers.compare_exchange_weak(previous, mods));
+	}
+	return false;
+}
+
 ISerial &LibmacroImpl::serial()
 {
 	return *_serial;
@@ -625,12 +625,10 @@ void MacroImpl::dispatchSignals()
 			continue;
 		if (!signalPtr)
 			continue;
-		auto *dispatcher = signalPtr->dispatcherPtr;
-		if (dispatcher) {
-			dispatcher->dispatch(signalPtr, 0);
-		} else {
+		if (_context)
+			_context->dispatch(signalPtr);
+		else
 			signalPtr->send();
-		}
 	}
 }
 
@@ -113,6 +113,8 @@ static const NameValue trigger_mode_names[] = {
 	{"Inequal", MCR_TM_INEQUAL},
 	{"Match", MCR_TM_MATCH},
 	{"Any", MCR_TM_ANY},
+	{"EqualOrNone", MCR_TM_EQUAL_OR_NONE},
+	{"Some", MCR_TM_SOME},
 	{"User", MCR_TM_USER},
 };
 
@@ -410,10 +412,10 @@ const char *SerialImpl::triggerModeName(mcr_TriggerMode value) const
 		return "Exclusive";
 	case MCR_TM_INEQUAL:
 		return "Inequal";
-	// case MCR_TM_EQUAL_OR_NONE:
-	// 	return "All or Nothing";
-	// case MCR_TM_SOME:
-	// 	return "Some";
+	case MCR_TM_EQUAL_OR_NONE:
+		return "EqualOrNone";
+	case MCR_TM_SOME:
+		return "Some";
 	case MCR_TM_ANY:
 		return "Any";
 	case MCR_TM_USER:
@@ -4,6 +4,38 @@
 
 #include "mcr/signal.h"
 
+#include "mcr/libmacro.h"
+
 namespace mcr
 {
+void SignalList::send(Libmacro *libmacroPtr) const
+{
+	Libmacro *context = Libmacro::instance(libmacroPtr);
+	for (mcr_index_t i = 0; i < count; i++) {
+		context->dispatch(array + i);
+	}
+}
+
+bool SignalCopy::assign(const Signal *signalPtr) noexcept
+{
+	if (signalPtr == _signalPtr)
+		return true;
+	reset();
+	if (!signalPtr)
+		return true;
+	try {
+		_signalPtr = signalPtr->copy(_memory, sizeof(_memory));
+	} catch (...) {
+		_signalPtr = nullptr;
+	}
+	return _signalPtr;
+}
+
+void SignalCopy::reset() noexcept
+{
+	if (_signalPtr) {
+		_signalPtr->~Signal();
+		_signalPtr = nullptr;
+	}
+}
 }
@@ -0,0 +1,18 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/signal/move_cursor.h"
+#include "mcr/error.h"
+
+namespace mcr
+{
+void (*MoveCursor::platformSend)(const MoveCursor &) = nullptr;
+
+void MoveCursor::send()
+{
+	if (!platformSend)
+		throw Error(ENOTSUP, "No platform to move the cursor");
+	platformSend(*this);
+}
+}
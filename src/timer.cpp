@@ -0,0 +1,147 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/timer.h"
+#include "mcr/error.h"
+#include "mcr/factory.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace mcr
+{
+
+/*! Timeouts ordered by deadline, and a thread sleeping until the first. */
+class Timer final : public ITimer {
+    public:
+	Timer() = default;
+	Timer(const Timer &) = delete;
+	virtual ~Timer() override;
+	Timer &operator=(const Timer &) = delete;
+
+	virtual uint64_t schedule(IActor *actorPtr,
+				  unsigned int millis) override;
+	virtual bool cancel(uint64_t id) override;
+	virtual size_t pendingCount() const override
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _ids.size();
+	}
+
+    private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	/*! Deadline and id, ids break ties in schedule order */
+	typedef std::pair<TimePoint, uint64_t> Deadline;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _acted;
+	std::map<Deadline, IActor *> _deadlines;
+	/*! Deadline of each pending id, to cancel */
+	std::unordered_map<uint64_t, TimePoint> _ids;
+	uint64_t _lastId = 0;
+	/*! Id of the actor acting now, or 0 */
+	uint64_t _actingId = 0;
+	bool _running = true;
+	std::thread _thread;
+
+	void run();
+};
+
+void ITimer::Deleter::operator()(ITimer *ptr) const
+{
+	delete ptr;
+}
+
+namespace factory
+{
+std::unique_ptr<ITimer, ITimer::Deleter> createTimer()
+{
+	return std::unique_ptr<ITimer, ITimer::Deleter>(new Timer());
+}
+
+std::shared_ptr<ITimer> createTimerShared()
+{
+	return createTimer();
+}
+}
+
+Timer::~Timer()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+		_wake.notify_one();
+	}
+	if (_thread.joinable())
+		_thread.join();
+}
+
+uint64_t Timer::schedule(IActor *actorPtr, unsigned int millis)
+{
+	if (!actorPtr)
+		throw Error(EINVAL, "Null timer actor");
+	const TimePoint deadline = std::chrono::steady_clock::now() +
+				   std::chrono::milliseconds(millis);
+	std::lock_guard<std::mutex> lock(_mutex);
+	const uint64_t id = ++_lastId;
+	_deadlines.emplace(Deadline(deadline, id), actorPtr);
+	_ids.emplace(id, deadline);
+	/* Started on first use, contexts without timeouts have no thread. */
+	if (!_thread.joinable())
+		_thread = std::thread(&Timer::run, this);
+	else if (_deadlines.begin()->first.second == id)
+		_wake.notify_one();
+	return id;
+}
+
+bool Timer::cancel(uint64_t id)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	auto found = _ids.find(id);
+	if (found != _ids.end()) {
+		_deadlines.erase(Deadline(found->second, id));
+		_ids.erase(found);
+		return true;
+	}
+	if (id && std::this_thread::get_id() != _thread.get_id())
+		_acted.wait(lock, [this, id] { return _actingId != id; });
+	return false;
+}
+
+void Timer::run()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (_running) {
+		if (_deadlines.empty()) {
+			_wake.wait(lock);
+			continue;
+		}
+		auto first = _deadlines.begin();
+		if (std::chrono::steady_clock::now() < first->first.first) {
+			_wake.wait_until(lock, first->first.first);
+			continue;
+		}
+		IActor *actorPtr = first->second;
+		_actingId = first->first.second;
+		_ids.erase(_actingId);
+		_deadlines.erase(first);
+		lock.unlock();
+		/* One actor throwing must not stop every other timeout. */
+		try {
+			actorPtr->act();
+		} catch (...) {
+		}
+		lock.lock();
+		_actingId = 0;
+		_acted.notify_all();
+	}
+}
+}
@@ -3,14 +3,51 @@
   SPDX-License-Identifier: LGPL-2.1-only */
 
 #include "mcr/trigger/action.h"
-#include "mcr/inline.h"
+#include "mcr/template/action.h"
 
 namespace mcr
 {
+typedef bool (*TriggerModeMatchFn)(unsigned int, unsigned int);
+
+/*! Built-in modes in order, then extended modes, then user modes */
+static const TriggerModeMatchFn triggerModeMatchers[] = {
+	&triggerModeMatch<MCR_TM_EQUAL>,
+	&triggerModeMatch<MCR_TM_ALL>,
+	&triggerModeMatch<MCR_TM_NONE>,
+	&triggerModeMatch<MCR_TM_EXCLUSIVE>,
+	&triggerModeMatch<MCR_TM_INEQUAL>,
+	&triggerModeMatch<MCR_TM_MATCH>,
+	&triggerModeMatch<MCR_TM_ANY>,
+	&triggerModeMatch<MCR_TM_EQUAL_OR_NONE>,
+	&triggerModeMatch<MCR_TM_SOME>,
+	&triggerModeMatch<MCR_TM_USER>,
+};
+static_assert(sizeof(triggerModeMatchers) / sizeof(*triggerModeMatchers) ==
+		      MCR_TM_USER + (MCR_TM_SOME + 1 - MCR_TM_EXTENDED) + 1,
+	      "Every trigger mode needs a matcher");
+
+/*! Index of a trigger mode in triggerModeMatchers */
+static inline unsigned int matcherIndex(unsigned int triggerMode) noexcept
+{
+	const auto user = static_cast<unsigned int>(MCR_TM_USER);
+	const auto extended = static_cast<unsigned int>(MCR_TM_EXTENDED);
+	const auto extendedEnd = static_cast<unsigned int>(MCR_TM_SOME) + 1;
+	if (triggerMode < user)
+		return triggerMode;
+	if (triggerMode >= extended && triggerMode < extendedEnd)
+		return user + triggerMode - extended;
+	return user + extendedEnd - extended;
+}
+
 bool Action::receive(Signal *signalPtr, unsigned int mods)
 {
-	if (!mcr_TriggerMode_match_inl(triggerMode, modifiers, mods))
+	if (!accepts(mods))
 		return false;
 	return trigger(signalPtr, mods); // blocking?
 }
+
+bool Action::accepts(unsigned int mods) const
+{
+	return triggerModeMatchers[matcherIndex(triggerMode)](modifiers, mods);
+}
 }
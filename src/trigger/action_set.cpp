@@ -0,0 +1,247 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/action_set.h"
+#include "mcr/epoch.h"
+#include "mcr/signal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*! Match words kept on the stack, larger groups are matched 256 nodes at
+ *  a time */
+#define MCR_ACTION_SET_STACK_WORDS 4
+
+namespace mcr
+{
+/*! Index of the lowest set bit, word must not be 0 */
+static inline unsigned int lowestBit(uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return static_cast<unsigned int>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return index;
+#else
+	unsigned int index = 0;
+	while (!(word & 1)) {
+		word >>= 1;
+		++index;
+	}
+	return index;
+#endif
+}
+
+/*! Dispatchers of groups, each once */
+static void addDispatchers(Signal *signalPtr,
+			   std::vector<IDispatcher *> *dispatchersOut)
+{
+	IDispatcher *dispatcher = signalPtr->dispatcherPtr;
+	if (dispatcher && std::find(dispatchersOut->begin(),
+				    dispatchersOut->end(),
+				    dispatcher) == dispatchersOut->end())
+		dispatchersOut->push_back(dispatcher);
+}
+
+ActionSet::~ActionSet()
+{
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	std::vector<IDispatcher *> dispatchers;
+	const Table *tablePtr = _table.load();
+	if (tablePtr) {
+		for (auto &typeGroups : tablePtr->groups) {
+			for (auto &keyGroup : typeGroups.second)
+				addDispatchers(keyGroup.second.signalPtr,
+					       &dispatchers);
+		}
+	}
+	for (auto dispatcher : dispatchers)
+		dispatcher->remove(this);
+	delete tablePtr;
+}
+
+bool ActionSet::receive(Signal *signalPtr, unsigned int mods)
+{
+	Epoch::Guard guard;
+	const Table *tablePtr = _table.load(std::memory_order_acquire);
+	if (!tablePtr || !signalPtr)
+		return false;
+	auto typeGroups = tablePtr->groups.find(signalPtr->name());
+	if (typeGroups == tablePtr->groups.end())
+		return false;
+	auto found = typeGroups->second.find(signalPtr->dispatchKey());
+	if (found == typeGroups->second.end())
+		return false;
+	const Group &group = found->second;
+	const size_t wordCount = group.table.wordCount();
+	uint64_t bits[MCR_ACTION_SET_STACK_WORDS];
+	bool blocked = false;
+	/* Every distinct predicate at once, in chunks of the stack words */
+	for (size_t first = 0; first < wordCount;
+	     first += MCR_ACTION_SET_STACK_WORDS) {
+		const size_t count = std::min<size_t>(
+			wordCount - first, MCR_ACTION_SET_STACK_WORDS);
+		group.table.match(mods, bits, first, count);
+		for (size_t i = 0; i < count; i++) {
+			for (uint64_t word = bits[i]; word; word &= word - 1) {
+				const size_t node =
+					(first + i) * 64 + lowestBit(word);
+				for (Action *actionPtr : group.actions[node]) {
+					if (actionPtr->trigger(signalPtr,
+							       mods))
+						blocked = true;
+				}
+			}
+		}
+	}
+	return blocked;
+}
+
+void ActionSet::add(Signal *signalPtr, Action *actionPtr)
+{
+	if (!signalPtr || !actionPtr)
+		return;
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	const Table *current = _table.load();
+	std::unique_ptr<Table> next(current ? new Table(*current) :
+					      new Table());
+	auto &keyGroups = next->groups[signalPtr->name()];
+	const size_t key = signalPtr->dispatchKey();
+	const bool newFlag = keyGroups.find(key) == keyGroups.end();
+	Group &group = keyGroups[key];
+	if (newFlag)
+		group.signalPtr = signalPtr;
+	const auto predicate =
+		std::make_pair(actionPtr->modifiers, actionPtr->triggerMode);
+	size_t node = std::find(group.predicates.begin(),
+				group.predicates.end(), predicate) -
+		      group.predicates.begin();
+	if (node == group.predicates.size()) {
+		group.table.add(predicate.first, predicate.second);
+		group.predicates.push_back(predicate);
+		group.actions.emplace_back();
+		++next->nodeCount;
+	}
+	auto &actions = group.actions[node];
+	if (std::find(actions.begin(), actions.end(), actionPtr) !=
+	    actions.end())
+		return;
+	actions.push_back(actionPtr);
+	++next->actionCount;
+	publish(next.release());
+	if (newFlag && signalPtr->dispatcherPtr)
+		signalPtr->dispatcherPtr->add(signalPtr, this);
+}
+
+void ActionSet::remove(Action *actionPtr)
+{
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	const Table *current = _table.load();
+	if (!current)
+		return;
+	std::unique_ptr<Table> next(new Table(*current));
+	std::vector<Signal *> removedSignals;
+	next->nodeCount = next->actionCount = 0;
+	for (auto &typeGroups : next->groups) {
+		auto &keyGroups = typeGroups.second;
+		for (auto iter = keyGroups.begin(); iter != keyGroups.end();) {
+			Group &group = iter->second;
+			Group kept;
+			kept.signalPtr = group.signalPtr;
+			for (size_t i = 0; i < group.actions.size(); i++) {
+				auto &actions = group.actions[i];
+				actions.erase(std::remove(actions.begin(),
+							  actions.end(),
+							  actionPtr),
+					      actions.end());
+				if (actions.empty())
+					continue;
+				const auto &predicate = group.predicates[i];
+				kept.table.add(predicate.first,
+					       predicate.second);
+				kept.predicates.push_back(predicate);
+				kept.actions.push_back(std::move(actions));
+				next->actionCount +=
+					kept.actions.back().size();
+			}
+			next->nodeCount += kept.predicates.size();
+			if (kept.predicates.empty()) {
+				removedSignals.push_back(group.signalPtr);
+				iter = keyGroups.erase(iter);
+			} else {
+				group = std::move(kept);
+				++iter;
+			}
+		}
+	}
+	const Table *tablePtr = next.release();
+	publish(tablePtr);
+	for (auto signalPtr : removedSignals)
+		removeDispatch(signalPtr, tablePtr);
+}
+
+void ActionSet::clear()
+{
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	const Table *current = _table.load();
+	if (!current)
+		return;
+	std::vector<IDispatcher *> removedDispatchers;
+	for (auto &typeGroups : current->groups) {
+		for (auto &keyGroup : typeGroups.second)
+			addDispatchers(keyGroup.second.signalPtr,
+				       &removedDispatchers);
+	}
+	publish(nullptr);
+	for (auto dispatcher : removedDispatchers)
+		dispatcher->remove(this);
+}
+
+size_t ActionSet::nodeCount() const
+{
+	Epoch::Guard guard;
+	const Table *tablePtr = _table.load(std::memory_order_acquire);
+	return tablePtr ? tablePtr->nodeCount : 0;
+}
+
+size_t ActionSet::actionCount() const
+{
+	Epoch::Guard guard;
+	const Table *tablePtr = _table.load(std::memory_order_acquire);
+	return tablePtr ? tablePtr->actionCount : 0;
+}
+
+void ActionSet::publish(const Table *tablePtr)
+{
+	std::unique_ptr<const Table> owned(tablePtr);
+	/* Retiring cannot fail after publishing. */
+	_retired.reserve();
+	_retired.retire(_table.exchange(owned.release()));
+	_retired.reclaim();
+}
+
+void ActionSet::removeDispatch(Signal *signalPtr, const Table *tablePtr)
+{
+	IDispatcher *dispatcher = signalPtr->dispatcherPtr;
+	if (!dispatcher || dispatcher->remove(signalPtr, this))
+		return;
+	/* Removes all entries of the set, add the groups still in the set
+	 * again. */
+	dispatcher->remove(this);
+	for (auto &typeGroups : tablePtr->groups) {
+		for (auto &keyGroup : typeGroups.second) {
+			Signal *groupSignalPtr = keyGroup.second.signalPtr;
+			if (groupSignalPtr->dispatcherPtr == dispatcher)
+				dispatcher->add(groupSignalPtr, this);
+		}
+	}
+}
+}
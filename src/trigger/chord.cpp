@@ -0,0 +1,113 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/chord.h"
+#include "mcr/libmacro.h"
+
+#include <algorithm>
+
+namespace mcr
+{
+Chord::Chord(const Chord &other)
+	: Trigger(other)
+	, context(other.context)
+	, windowMillis(other.windowMillis)
+	, _masks(other._masks)
+	, _keys(other._keys)
+{
+}
+
+Chord &Chord::operator=(const Chord &other)
+{
+	if (&other == this)
+		return *this;
+	Trigger::operator=(other);
+	context = other.context;
+	windowMillis = other.windowMillis;
+	_masks = other._masks;
+	_keys = other._keys;
+	_triggeredFlag = false;
+	return *this;
+}
+
+bool Chord::receive(Signal *signalPtr, unsigned int mods)
+{
+	int key;
+	mcr_ApplyValue apply;
+	if (!signalPtr || !signalPtr->keyPress(&key, &apply) || !hasKey(key))
+		return false;
+	if (apply == MCR_UNSET) {
+		_triggeredFlag = false;
+		return false;
+	}
+	const KeyState &state = Libmacro::instance(context)->keyState();
+	for (auto &mask : _masks) {
+		if ((state.word(mask.index) & mask.bits) != mask.bits)
+			return false;
+	}
+	uint64_t first = UINT64_MAX, last = 0;
+	for (int chordKey : _keys) {
+		const uint64_t pressTime = state.pressTime(chordKey);
+		first = std::min(first, pressTime);
+		last = std::max(last, pressTime);
+	}
+	if (last - first > uint64_t(windowMillis) * 1000000)
+		return false;
+	/* Key repeat does not trigger again, pressed and released does. */
+	if (_triggeredFlag.exchange(apply != MCR_BOTH))
+		return false;
+	return trigger(signalPtr, mods);
+}
+
+void Chord::addKey(int key)
+{
+	const auto index = static_cast<unsigned int>(key);
+	if (index >= MCR_KEY_STATE_COUNT)
+		throw Error(ERANGE, "Chord key code out of key state range");
+	if (hasKey(key))
+		return;
+	const uint64_t bit = uint64_t(1) << (index % 64);
+	_keys.push_back(key);
+	for (auto &mask : _masks) {
+		if (mask.index == index / 64) {
+			mask.bits |= bit;
+			return;
+		}
+	}
+	_masks.push_back(KeyMask{index / 64, bit});
+}
+
+void Chord::removeKey(int key) noexcept
+{
+	if (!hasKey(key))
+		return;
+	const auto index = static_cast<unsigned int>(key);
+	_keys.erase(std::find(_keys.begin(), _keys.end(), key));
+	for (auto iter = _masks.begin(); iter != _masks.end(); ++iter) {
+		if (iter->index == index / 64) {
+			iter->bits &= ~(uint64_t(1) << (index % 64));
+			if (!iter->bits)
+				_masks.erase(iter);
+			return;
+		}
+	}
+}
+
+void Chord::clearKeys() noexcept
+{
+	_keys.clear();
+	_masks.clear();
+	_triggeredFlag = false;
+}
+
+bool Chord::hasKey(int key) const noexcept
+{
+	const auto index = static_cast<unsigned int>(key);
+	for (auto &mask : _masks) {
+		if (mask.index == index / 64)
+			return mask.bits & (uint64_t(1) << (index % 64));
+	}
+	return false;
+}
+}
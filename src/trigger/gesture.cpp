@@ -0,0 +1,329 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/gesture.h"
+#include "mcr/key_state.h"
+#include "mcr/signal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <utility>
+
+/* Not yet a trie edge while compiling */
+#define MCR_GESTURE_NO_STATE UINT32_MAX
+
+namespace mcr
+{
+static const size_t directionCount = Gesture::DIRECTION_COUNT;
+
+Gesture::Gesture() : Trigger(), _recognizer(new GestureRecognizer(this))
+{
+}
+
+Gesture::Gesture(std::initializer_list<Direction> directions)
+	: Trigger()
+	, _strokes(directions)
+	, _recognizer(new GestureRecognizer(this))
+{
+}
+
+Gesture::Gesture(const Gesture &other)
+	: Trigger(other)
+	, maxMillis(other.maxMillis)
+	, _strokes(other._strokes)
+	, _recognizer(new GestureRecognizer(this))
+{
+}
+
+Gesture::~Gesture() = default;
+
+Gesture &Gesture::operator=(const Gesture &other)
+{
+	if (&other == this)
+		return *this;
+	Trigger::operator=(other);
+	maxMillis = other.maxMillis;
+	setStrokes(other._strokes);
+	_recognizer->reset();
+	return *this;
+}
+
+bool Gesture::receive(Signal *signalPtr, unsigned int mods)
+{
+	return _recognizer->receive(signalPtr, mods);
+}
+
+void Gesture::setStrokes(std::vector<Direction> directions)
+{
+	/* The private recognizer reads strokes while compiling. */
+	std::lock_guard<std::mutex> lock(_recognizer->_mutex);
+	_strokes = std::move(directions);
+	_recognizer->_compiledFlag = false;
+}
+
+GestureRecognizer::GestureRecognizer(Gesture *alonePtr)
+	: _gestures{ alonePtr }
+{
+}
+
+bool GestureRecognizer::receive(Signal *signalPtr, unsigned int mods)
+{
+	SpacePosition position;
+	bool relativeFlag;
+	if (!signalPtr || !signalPtr->motion(&position, &relativeFlag))
+		return false;
+	return sample(position, relativeFlag, KeyState::now(), signalPtr,
+		      mods);
+}
+
+bool GestureRecognizer::sample(const SpacePosition &position,
+			       bool relativeFlag, uint64_t timestamp,
+			       Signal *signalPtr, unsigned int mods)
+{
+	if (horizontal >= MCR_DIMENSION_COUNT ||
+	    vertical >= MCR_DIMENSION_COUNT)
+		return false;
+	Matched matched;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		advance(position, relativeFlag, timestamp, matched);
+	}
+	bool blocked = false;
+	for (size_t i = 0; i < matched.count; i++)
+		blocked |= matched.gestures[i]->trigger(signalPtr, mods);
+	for (auto gesturePtr : matched.overflow)
+		blocked |= gesturePtr->trigger(signalPtr, mods);
+	return blocked;
+}
+
+void GestureRecognizer::advance(const SpacePosition &position,
+				bool relativeFlag, uint64_t timestamp,
+				Matched &matched)
+{
+	if (!_compiledFlag)
+		compile();
+	if (timestamp - _lastTime > uint64_t(idleMillis) * 1000000)
+		restart();
+	_lastTime = timestamp;
+	long long dx = position.array[horizontal];
+	long long dy = position.array[vertical];
+	if (!relativeFlag) {
+		const bool firstFlag = !_lastFlag;
+		dx -= _last.array[horizontal];
+		dy -= _last.array[vertical];
+		_last = position;
+		_lastFlag = true;
+		if (firstFlag)
+			return;
+	}
+	_dx += dx;
+	_dy += dy;
+	/* Resample by distance, without a buffer of samples */
+	const double step = stepDistance ? stepDistance : 1;
+	const double distance =
+		std::sqrt(double(_dx) * _dx + double(_dy) * _dy);
+	const auto steps = static_cast<unsigned int>(distance / step);
+	if (!steps)
+		return;
+	const int next = direction(_dx, _dy);
+	/* Motion past the last step counts toward the next. */
+	const double used = steps * step / distance;
+	_dx -= std::llround(_dx * used);
+	_dy -= std::llround(_dy * used);
+	if (next != _run) {
+		_run = next;
+		_runSteps = 0;
+		_runTime = timestamp;
+	}
+	const bool strokeFlag =
+		_runSteps < strokeSteps && _runSteps + steps >= strokeSteps;
+	_runSteps += steps;
+	/* Jitter between strokes does not repeat the last stroke. */
+	if (strokeFlag && _run != _stroke)
+		stroke(_run, timestamp, matched);
+}
+
+void GestureRecognizer::stroke(int direction, uint64_t timestamp,
+			       Matched &matched)
+{
+	_stroke = direction;
+	_strokeTimes[_strokeCount++ % _strokeTimes.size()] = _runTime;
+	_state = _transitions[_state * directionCount + direction];
+	for (uint32_t i = _outputStarts[_state];
+	     i < _outputStarts[_state + 1]; i++) {
+		const Pattern &pattern = _patterns[_outputs[i]];
+		Gesture *gesturePtr = pattern.gesturePtr;
+		const uint64_t first =
+			_strokeTimes[(_strokeCount - pattern.length) %
+				     _strokeTimes.size()];
+		const uint64_t maxNanos = uint64_t(gesturePtr->maxMillis) * 1000000;
+		if (maxNanos && timestamp - first > maxNanos)
+			continue;
+		if (matched.count < MCR_GESTURE_MATCH_COUNT)
+			matched.gestures[matched.count++] = gesturePtr;
+		else
+			matched.overflow.push_back(gesturePtr);
+	}
+}
+
+void GestureRecognizer::add(Gesture *gesturePtr)
+{
+	if (!gesturePtr)
+		return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (std::find(_gestures.begin(), _gestures.end(), gesturePtr) ==
+	    _gestures.end())
+		_gestures.push_back(gesturePtr);
+	_compiledFlag = false;
+}
+
+void GestureRecognizer::remove(Gesture *gesturePtr)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_gestures.erase(std::remove(_gestures.begin(), _gestures.end(),
+				    gesturePtr),
+			_gestures.end());
+	_compiledFlag = false;
+}
+
+void GestureRecognizer::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_gestures.clear();
+	_compiledFlag = false;
+}
+
+void GestureRecognizer::invalidate()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_compiledFlag = false;
+}
+
+void GestureRecognizer::reset()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	restart();
+	_lastFlag = false;
+}
+
+size_t GestureRecognizer::stateCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_compiledFlag)
+		compile();
+	return _outputStarts.size() - 1;
+}
+
+Gesture::Direction GestureRecognizer::direction(long long dx,
+						long long dy) noexcept
+{
+	/* Octants split at tan(22.5 degrees), about 12 / 29 */
+	const long long ax = dx < 0 ? -dx : dx, ay = dy < 0 ? -dy : dy;
+	if (ay * 29 <= ax * 12)
+		return dx < 0 ? Gesture::WEST : Gesture::EAST;
+	if (ax * 29 <= ay * 12)
+		return dy < 0 ? Gesture::NORTH : Gesture::SOUTH;
+	if (dx < 0)
+		return dy < 0 ? Gesture::NORTHWEST : Gesture::SOUTHWEST;
+	return dy < 0 ? Gesture::NORTHEAST : Gesture::SOUTHEAST;
+}
+
+void GestureRecognizer::restart() noexcept
+{
+	_state = 0;
+	_dx = _dy = 0;
+	_run = _stroke = -1;
+	_runSteps = 0;
+}
+
+void GestureRecognizer::compile()
+{
+	_patterns.clear();
+	size_t longest = 1;
+	for (auto gesturePtr : _gestures) {
+		/* Strokes may have changed since added. */
+		const auto &strokes = gesturePtr->strokes();
+		if (strokes.empty() ||
+		    std::any_of(strokes.begin(), strokes.end(),
+				[](Gesture::Direction direction) {
+					return static_cast<unsigned int>(
+						       direction) >=
+					       directionCount;
+				}))
+			continue;
+		/* Only a change of direction separates strokes. */
+		if (std::adjacent_find(strokes.begin(), strokes.end()) !=
+		    strokes.end())
+			continue;
+		_patterns.push_back(Pattern{ gesturePtr, strokes.size() });
+		longest = std::max(longest, strokes.size());
+	}
+
+	/* Trie of all patterns */
+	std::vector<std::vector<uint32_t>> ends(1);
+	_transitions.assign(directionCount, MCR_GESTURE_NO_STATE);
+	for (size_t i = 0; i < _patterns.size(); i++) {
+		uint32_t state = 0;
+		for (auto direction : _patterns[i].gesturePtr->strokes()) {
+			const size_t edge = state * directionCount + direction;
+			if (_transitions[edge] == MCR_GESTURE_NO_STATE) {
+				_transitions[edge] =
+					static_cast<uint32_t>(ends.size());
+				ends.emplace_back();
+				_transitions.resize(ends.size() *
+							    directionCount,
+						    MCR_GESTURE_NO_STATE);
+			}
+			state = _transitions[edge];
+		}
+		ends[state].push_back(static_cast<uint32_t>(i));
+	}
+
+	/* Breadth first, fill missing edges from failure links, and inherit
+	 * patterns ending at the failure state. */
+	std::vector<uint32_t> failures(ends.size(), 0);
+	std::deque<uint32_t> queue;
+	for (size_t direction = 0; direction < directionCount; direction++) {
+		uint32_t &next = _transitions[direction];
+		if (next == MCR_GESTURE_NO_STATE)
+			next = 0;
+		else
+			queue.push_back(next);
+	}
+	while (!queue.empty()) {
+		const uint32_t state = queue.front();
+		queue.pop_front();
+		const auto &inherited = ends[failures[state]];
+		ends[state].insert(ends[state].end(), inherited.begin(),
+				   inherited.end());
+		for (size_t direction = 0; direction < directionCount;
+		     direction++) {
+			uint32_t &next =
+				_transitions[state * directionCount + direction];
+			const uint32_t fallback =
+				_transitions[failures[state] * directionCount +
+					     direction];
+			if (next == MCR_GESTURE_NO_STATE) {
+				next = fallback;
+			} else {
+				failures[next] = fallback;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	_outputs.clear();
+	_outputStarts.assign(1, 0);
+	for (auto &stateEnds : ends) {
+		_outputs.insert(_outputs.end(), stateEnds.begin(),
+				stateEnds.end());
+		_outputStarts.push_back(static_cast<uint32_t>(_outputs.size()));
+	}
+	_strokeTimes.assign(longest, 0);
+	_strokeCount = 0;
+	restart();
+	_compiledFlag = true;
+}
+}
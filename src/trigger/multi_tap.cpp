@@ -0,0 +1,121 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/multi_tap.h"
+#include "mcr/key_state.h"
+#include "mcr/signal.h"
+
+#define MCR_MULTI_TAP_PRESSED (uint64_t(1) << 63)
+#define MCR_MULTI_TAP_SHIFT 56
+/* Times wrap every 2 ^ 56 nanoseconds, more than two years. */
+#define MCR_MULTI_TAP_TIME ((uint64_t(1) << MCR_MULTI_TAP_SHIFT) - 1)
+
+namespace mcr
+{
+MultiTap::MultiTap(const MultiTap &other)
+	: Trigger(other)
+	, key(other.key)
+	, count(other.count)
+	, windowMillis(other.windowMillis)
+	, windowCloseFlag(other.windowCloseFlag)
+{
+}
+
+MultiTap &MultiTap::operator=(const MultiTap &other)
+{
+	if (&other == this)
+		return *this;
+	Trigger::operator=(other);
+	key = other.key;
+	count = other.count;
+	windowMillis = other.windowMillis;
+	windowCloseFlag = other.windowCloseFlag;
+	reset();
+	return *this;
+}
+
+bool MultiTap::receive(Signal *signalPtr, unsigned int mods)
+{
+	int pressedKey;
+	mcr_ApplyValue apply;
+	/* Any event may be the first after the window closed.  It is not
+	 * blocked for the closed window, it belongs to the next one or to
+	 * another key. */
+	if (windowCloseFlag)
+		resolve(signalPtr, mods);
+	if (!signalPtr || !signalPtr->keyPress(&pressedKey, &apply) ||
+	    pressedKey != key)
+		return false;
+	if (apply == MCR_UNSET) {
+		_state.fetch_and(~MCR_MULTI_TAP_PRESSED,
+				 std::memory_order_relaxed);
+		return false;
+	}
+	const uint64_t now = KeyState::now() & MCR_MULTI_TAP_TIME;
+	const uint64_t window = uint64_t(windowMillis) * 1000000;
+	unsigned int target = count;
+	if (target > MAX_COUNT)
+		target = MAX_COUNT;
+	else if (!target)
+		target = 1;
+	uint64_t state = _state.load(std::memory_order_relaxed);
+	uint64_t next;
+	bool triggerFlag;
+	do {
+		/* Key repeat */
+		if ((state & MCR_MULTI_TAP_PRESSED) && apply != MCR_BOTH)
+			return false;
+		uint64_t taps = (state >> MCR_MULTI_TAP_SHIFT) & MAX_COUNT;
+		if (taps &&
+		    ((now - state) & MCR_MULTI_TAP_TIME) > window)
+			taps = 0;
+		triggerFlag = ++taps >= target;
+		if (triggerFlag)
+			taps = 0;
+		next = (apply == MCR_BOTH ? 0 : MCR_MULTI_TAP_PRESSED) |
+		       taps << MCR_MULTI_TAP_SHIFT | now;
+	} while (!_state.compare_exchange_weak(state, next,
+					       std::memory_order_relaxed));
+	if (!triggerFlag)
+		return false;
+	_resolvedTaps.store(target, std::memory_order_relaxed);
+	return trigger(signalPtr, mods);
+}
+
+bool MultiTap::resolve(Signal *signalPtr, unsigned int mods)
+{
+	const uint64_t now = KeyState::now() & MCR_MULTI_TAP_TIME;
+	const uint64_t window = uint64_t(windowMillis) * 1000000;
+	uint64_t state = _state.load(std::memory_order_relaxed);
+	uint64_t taps;
+	do {
+		taps = (state >> MCR_MULTI_TAP_SHIFT) & MAX_COUNT;
+		if (!taps || ((now - state) & MCR_MULTI_TAP_TIME) <= window)
+			return false;
+		/* Keep pressed, a held key does not tap again */
+	} while (!_state.compare_exchange_weak(
+		state, state & MCR_MULTI_TAP_PRESSED,
+		std::memory_order_relaxed));
+	_resolvedTaps.store((unsigned int)taps, std::memory_order_relaxed);
+	return trigger(signalPtr, mods);
+}
+
+unsigned int MultiTap::taps() const noexcept
+{
+	return (_state.load(std::memory_order_relaxed) >>
+		MCR_MULTI_TAP_SHIFT) &
+	       MAX_COUNT;
+}
+
+unsigned int MultiTap::resolvedTaps() const noexcept
+{
+	return _resolvedTaps.load(std::memory_order_relaxed);
+}
+
+void MultiTap::reset() noexcept
+{
+	_state.store(0, std::memory_order_relaxed);
+	_resolvedTaps.store(0, std::memory_order_relaxed);
+}
+}
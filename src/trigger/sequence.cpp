@@ -0,0 +1,353 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/sequence.h"
+#include "mcr/error.h"
+#include "mcr/key_state.h"
+#include "mcr/signal.h"
+
+#include <algorithm>
+#include <deque>
+#include <initializer_list>
+
+/* Not yet a trie edge while compiling */
+#define MCR_SEQUENCE_NO_STATE UINT32_MAX
+
+namespace mcr
+{
+namespace
+{
+struct KeyModifier {
+	int key;
+	unsigned int modifiers;
+};
+}
+
+static bool isModifierDefault(int key) noexcept
+{
+	for (auto &pair :
+	     std::initializer_list<KeyModifier>{ MCR_KEY_MODIFIER_DEFAULTS }) {
+		if (pair.key == key)
+			return true;
+	}
+	return false;
+}
+
+/*! Press or release a held key, _mutex of the caller must be locked.
+ *  @return true if newly pressed */
+static bool pressHeld(std::vector<bool> &heldKeys, int key,
+		      mcr_ApplyValue apply) noexcept
+{
+	const auto index = static_cast<unsigned int>(key);
+	if (index >= MCR_KEY_STATE_COUNT)
+		return apply != MCR_UNSET;
+	const bool held = heldKeys[index];
+	switch (apply) {
+	case MCR_SET:
+		heldKeys[index] = true;
+		return !held;
+	case MCR_UNSET:
+		heldKeys[index] = false;
+		return false;
+	case MCR_BOTH:
+		heldKeys[index] = false;
+		return true;
+	case MCR_TOGGLE:
+		heldKeys[index] = !held;
+		return !held;
+	}
+	return false;
+}
+
+Sequence::Sequence(const Sequence &other)
+	: Trigger(other)
+	, keys(other.keys)
+	, timeoutMillis(other.timeoutMillis)
+{
+}
+
+Sequence &Sequence::operator=(const Sequence &other)
+{
+	if (&other == this)
+		return *this;
+	Trigger::operator=(other);
+	keys = other.keys;
+	timeoutMillis = other.timeoutMillis;
+	reset();
+	return *this;
+}
+
+bool Sequence::receive(Signal *signalPtr, unsigned int mods)
+{
+	int key;
+	mcr_ApplyValue apply;
+	if (!signalPtr || !signalPtr->keyPress(&key, &apply))
+		return false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!pressHeld(_heldKeys, key, apply))
+			return false;
+		if (_compiledKeys != keys)
+			compile();
+		const size_t length = _compiledKeys.size();
+		if (!length)
+			return false;
+		if (std::find(_compiledKeys.begin(), _compiledKeys.end(),
+			      key) == _compiledKeys.end()) {
+			if (!isModifierDefault(key))
+				_matchedCount = 0;
+			return false;
+		}
+		while (_matchedCount &&
+		       (_matchedCount == length ||
+			_compiledKeys[_matchedCount] != key))
+			_matchedCount = _failures[_matchedCount - 1];
+		if (_compiledKeys[_matchedCount] == key)
+			++_matchedCount;
+		const uint64_t now = KeyState::now();
+		_times[_position++ % length] = now;
+		if (_matchedCount != length ||
+		    now - _times[_position % length] >
+			    uint64_t(timeoutMillis) * 1000000)
+			return false;
+	}
+	return trigger(signalPtr, mods);
+}
+
+void Sequence::reset()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_matchedCount = 0;
+	std::fill(_heldKeys.begin(), _heldKeys.end(), false);
+}
+
+void Sequence::compile()
+{
+	_compiledKeys = keys;
+	const size_t length = _compiledKeys.size();
+	_failures.assign(length, 0);
+	for (size_t i = 1, matched = 0; i < length; i++) {
+		while (matched && _compiledKeys[i] != _compiledKeys[matched])
+			matched = _failures[matched - 1];
+		if (_compiledKeys[i] == _compiledKeys[matched])
+			++matched;
+		_failures[i] = matched;
+	}
+	_times.assign(length, 0);
+	_position = 0;
+	_matchedCount = 0;
+}
+
+SequenceAutomaton::SequenceAutomaton()
+	: _symbols(MCR_KEY_STATE_COUNT, -1)
+	, _ignored(MCR_KEY_STATE_COUNT, false)
+	, _heldKeys(MCR_KEY_STATE_COUNT, false)
+{
+	for (auto &pair :
+	     std::initializer_list<KeyModifier>{ MCR_KEY_MODIFIER_DEFAULTS }) {
+		if (static_cast<unsigned int>(pair.key) < MCR_KEY_STATE_COUNT)
+			_ignored[pair.key] = true;
+	}
+}
+
+bool SequenceAutomaton::receive(Signal *signalPtr, unsigned int mods)
+{
+	int key;
+	mcr_ApplyValue apply;
+	if (!signalPtr || !signalPtr->keyPress(&key, &apply))
+		return false;
+	const auto index = static_cast<unsigned int>(key);
+	Sequence *matched[MCR_SEQUENCE_MATCH_COUNT];
+	size_t matchedCount = 0;
+	/* Only allocated if more sequences end together */
+	std::vector<Sequence *> overflow;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!pressHeld(_heldKeys, key, apply))
+			return false;
+		if (!_compiledFlag)
+			compile();
+		const int symbol =
+			index < MCR_KEY_STATE_COUNT ? _symbols[index] : -1;
+		if (symbol < 0) {
+			if (index >= MCR_KEY_STATE_COUNT || !_ignored[index])
+				_state = 0;
+			return false;
+		}
+		_state = _transitions[_state * _symbolCount + symbol];
+		const uint64_t now = KeyState::now();
+		_times[_position++ % _times.size()] = now;
+		for (uint32_t i = _outputStarts[_state];
+		     i < _outputStarts[_state + 1]; i++) {
+			const Pattern &pattern = _patterns[_outputs[i]];
+			const uint64_t first =
+				_times[(_position - pattern.length) %
+				       _times.size()];
+			Sequence *sequencePtr = pattern.sequencePtr;
+			if (now - first >
+			    uint64_t(sequencePtr->timeoutMillis) * 1000000)
+				continue;
+			if (matchedCount < MCR_SEQUENCE_MATCH_COUNT)
+				matched[matchedCount++] = sequencePtr;
+			else
+				overflow.push_back(sequencePtr);
+		}
+	}
+	bool blocked = false;
+	for (size_t i = 0; i < matchedCount; i++)
+		blocked |= matched[i]->trigger(signalPtr, mods);
+	for (auto sequencePtr : overflow)
+		blocked |= sequencePtr->trigger(signalPtr, mods);
+	return blocked;
+}
+
+void SequenceAutomaton::add(Sequence *sequencePtr)
+{
+	if (!sequencePtr)
+		return;
+	for (int key : sequencePtr->keys) {
+		if (static_cast<unsigned int>(key) >= MCR_KEY_STATE_COUNT)
+			throw Error(ERANGE, "Sequence key code out of range");
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (std::find(_sequences.begin(), _sequences.end(), sequencePtr) ==
+	    _sequences.end())
+		_sequences.push_back(sequencePtr);
+	_compiledFlag = false;
+}
+
+void SequenceAutomaton::remove(Sequence *sequencePtr)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_sequences.erase(std::remove(_sequences.begin(), _sequences.end(),
+				     sequencePtr),
+			 _sequences.end());
+	_compiledFlag = false;
+}
+
+void SequenceAutomaton::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_sequences.clear();
+	_compiledFlag = false;
+}
+
+void SequenceAutomaton::invalidate()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_compiledFlag = false;
+}
+
+void SequenceAutomaton::ignoreKey(int key, bool ignoreFlag)
+{
+	const auto index = static_cast<unsigned int>(key);
+	if (index >= MCR_KEY_STATE_COUNT)
+		throw Error(ERANGE, "Key code out of range");
+	std::lock_guard<std::mutex> lock(_mutex);
+	_ignored[index] = ignoreFlag;
+}
+
+void SequenceAutomaton::reset()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_state = 0;
+	std::fill(_heldKeys.begin(), _heldKeys.end(), false);
+}
+
+size_t SequenceAutomaton::stateCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_compiledFlag)
+		compile();
+	return _outputStarts.size() - 1;
+}
+
+void SequenceAutomaton::compile()
+{
+	_patterns.clear();
+	std::fill(_symbols.begin(), _symbols.end(), -1);
+	_symbolCount = 0;
+	size_t longest = 1;
+	for (auto sequencePtr : _sequences) {
+		/* Keys may have changed since added. */
+		const auto &keys = sequencePtr->keys;
+		if (keys.empty() ||
+		    std::any_of(keys.begin(), keys.end(), [](int key) {
+			    return static_cast<unsigned int>(key) >=
+				   MCR_KEY_STATE_COUNT;
+		    }))
+			continue;
+		for (int key : keys) {
+			if (_symbols[key] < 0)
+				_symbols[key] = static_cast<int16_t>(_symbolCount++);
+		}
+		_patterns.push_back(Pattern{ sequencePtr, keys.size() });
+		longest = std::max(longest, keys.size());
+	}
+	const size_t width = std::max<size_t>(_symbolCount, 1);
+
+	/* Trie of all patterns */
+	std::vector<std::vector<uint32_t>> ends(1);
+	_transitions.assign(width, MCR_SEQUENCE_NO_STATE);
+	for (size_t i = 0; i < _patterns.size(); i++) {
+		uint32_t state = 0;
+		for (int key : _patterns[i].sequencePtr->keys) {
+			uint32_t &next =
+				_transitions[state * width + _symbols[key]];
+			if (next == MCR_SEQUENCE_NO_STATE) {
+				next = static_cast<uint32_t>(ends.size());
+				ends.emplace_back();
+				_transitions.resize(ends.size() * width,
+						    MCR_SEQUENCE_NO_STATE);
+			}
+			/* resize may have moved next */
+			state = _transitions[state * width + _symbols[key]];
+		}
+		ends[state].push_back(static_cast<uint32_t>(i));
+	}
+
+	/* Breadth first, fill missing edges from failure links, and inherit
+	 * patterns ending at the failure state. */
+	std::vector<uint32_t> failures(ends.size(), 0);
+	std::deque<uint32_t> queue;
+	for (size_t symbol = 0; symbol < width; symbol++) {
+		uint32_t &next = _transitions[symbol];
+		if (next == MCR_SEQUENCE_NO_STATE)
+			next = 0;
+		else
+			queue.push_back(next);
+	}
+	while (!queue.empty()) {
+		const uint32_t state = queue.front();
+		queue.pop_front();
+		const auto &inherited = ends[failures[state]];
+		ends[state].insert(ends[state].end(), inherited.begin(),
+				   inherited.end());
+		for (size_t symbol = 0; symbol < width; symbol++) {
+			uint32_t &next = _transitions[state * width + symbol];
+			const uint32_t fallback =
+				_transitions[failures[state] * width + symbol];
+			if (next == MCR_SEQUENCE_NO_STATE) {
+				next = fallback;
+			} else {
+				failures[next] = fallback;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	_outputs.clear();
+	_outputStarts.assign(1, 0);
+	for (auto &stateEnds : ends) {
+		_outputs.insert(_outputs.end(), stateEnds.begin(),
+				stateEnds.end());
+		_outputStarts.push_back(static_cast<uint32_t>(_outputs.size()));
+	}
+	_symbolCount = width;
+	_times.assign(longest, 0);
+	_position = 0;
+	_state = 0;
+	_compiledFlag = true;
+}
+}
@@ -0,0 +1,200 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/table.h"
+#include "mcr/error.h"
+#include "mcr/trigger/action.h"
+
+#include <algorithm>
+
+/* Rows matched at once, chosen at compile time */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MCR_TRIGGER_TABLE_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MCR_TRIGGER_TABLE_LANES 4
+#else
+#define MCR_TRIGGER_TABLE_LANES 1
+#endif
+
+/* Rows are padded for the widest lanes, so every build reads whole
+ * blocks. */
+#define MCR_TRIGGER_TABLE_PAD 8
+
+namespace mcr
+{
+size_t TriggerTable::add(unsigned int modifiers, unsigned int triggerMode)
+{
+	const size_t index = _size;
+	if (index % MCR_TRIGGER_TABLE_PAD == 0) {
+		_modifiers.resize(index + MCR_TRIGGER_TABLE_PAD, 0);
+		_truths.resize(index + MCR_TRIGGER_TABLE_PAD, 0);
+	}
+	_modifiers[index] = modifiers;
+	_truths[index] = truth(triggerMode);
+	++_size;
+	return index;
+}
+
+size_t TriggerTable::add(const Action &action)
+{
+	return add(action.modifiers, action.triggerMode);
+}
+
+void TriggerTable::set(size_t index, unsigned int modifiers,
+		       unsigned int triggerMode)
+{
+	if (index >= _size)
+		throw Error(ERANGE, "Trigger table index out of range");
+	_modifiers[index] = modifiers;
+	_truths[index] = truth(triggerMode);
+}
+
+void TriggerTable::clear() noexcept
+{
+	_modifiers.clear();
+	_truths.clear();
+	_size = 0;
+}
+
+void TriggerTable::match(unsigned int mods, uint64_t *bitsOut) const noexcept
+{
+	match(mods, bitsOut, 0, wordCount());
+}
+
+void TriggerTable::match(unsigned int mods, uint64_t *bitsOut,
+			 size_t firstWord, size_t count) const noexcept
+{
+	if (!bitsOut)
+		return;
+	std::fill(bitsOut, bitsOut + count, 0);
+	const uint32_t *modifiers = _modifiers.data();
+	const uint32_t *truths = _truths.data();
+	/* Padding never matches, whole blocks may be read.  Words start
+	 * at a whole block. */
+	const size_t end =
+		std::min(_modifiers.size(), (firstWord + count) * 64);
+	size_t i = firstWord * 64;
+#if MCR_TRIGGER_TABLE_LANES == 8
+	const __m256i incoming = _mm256_set1_epi32(static_cast<int>(mods));
+	const __m256i zero = _mm256_setzero_si256();
+	for (; i < end; i += 8) {
+		const __m256i mods8 = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i *>(modifiers + i));
+		const __m256i truth8 = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i *>(truths + i));
+		const __m256i both = _mm256_and_si256(mods8, incoming);
+		__m256i index = _mm256_and_si256(
+			_mm256_cmpeq_epi32(mods8, incoming),
+			_mm256_set1_epi32(1));
+		index = _mm256_or_si256(
+			index, _mm256_and_si256(_mm256_cmpeq_epi32(both, mods8),
+						_mm256_set1_epi32(2)));
+		index = _mm256_or_si256(
+			index, _mm256_and_si256(_mm256_cmpeq_epi32(both, zero),
+						_mm256_set1_epi32(4)));
+		index = _mm256_or_si256(
+			index,
+			_mm256_and_si256(
+				_mm256_cmpeq_epi32(
+					_mm256_andnot_si256(mods8, incoming),
+					zero),
+				_mm256_set1_epi32(8)));
+		/* Truth bit to the sign bit */
+		const __m256i hit = _mm256_slli_epi32(
+			_mm256_srlv_epi32(truth8, index), 31);
+		const uint64_t bits = static_cast<unsigned int>(
+			_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+		bitsOut[i / 64 - firstWord] |= bits << (i % 64);
+	}
+#elif MCR_TRIGGER_TABLE_LANES == 4
+	const __m128i incoming = _mm_set1_epi32(static_cast<int>(mods));
+	const __m128i zero = _mm_setzero_si128();
+	for (; i < end; i += 4) {
+		const __m128i mods4 = _mm_loadu_si128(
+			reinterpret_cast<const __m128i *>(modifiers + i));
+		const __m128i truth4 = _mm_loadu_si128(
+			reinterpret_cast<const __m128i *>(truths + i));
+		const __m128i both = _mm_and_si128(mods4, incoming);
+		__m128i index = _mm_and_si128(_mm_cmpeq_epi32(mods4, incoming),
+					      _mm_set1_epi32(1));
+		index = _mm_or_si128(index,
+				     _mm_and_si128(_mm_cmpeq_epi32(both, mods4),
+						   _mm_set1_epi32(2)));
+		index = _mm_or_si128(index,
+				     _mm_and_si128(_mm_cmpeq_epi32(both, zero),
+						   _mm_set1_epi32(4)));
+		index = _mm_or_si128(
+			index,
+			_mm_and_si128(_mm_cmpeq_epi32(
+					      _mm_andnot_si128(mods4, incoming),
+					      zero),
+				      _mm_set1_epi32(8)));
+		/* SSE2 has no variable shift.  2^index is the float with
+		 * exponent index, converted back to an integer. */
+		const __m128i bit = _mm_cvttps_epi32(_mm_castsi128_ps(
+			_mm_slli_epi32(_mm_add_epi32(index, _mm_set1_epi32(127)),
+				       23)));
+		const __m128i miss =
+			_mm_cmpeq_epi32(_mm_and_si128(truth4, bit), zero);
+		const uint64_t bits = ~static_cast<unsigned int>(
+					      _mm_movemask_ps(
+						      _mm_castsi128_ps(miss))) &
+				      0xF;
+		bitsOut[i / 64 - firstWord] |= bits << (i % 64);
+	}
+#else
+	for (; i < end; i++) {
+		const uint64_t bit =
+			(truths[i] >> predicates(modifiers[i], mods)) & 1;
+		bitsOut[i / 64 - firstWord] |= bit << (i % 64);
+	}
+#endif
+}
+
+uint32_t TriggerTable::truth(unsigned int triggerMode) noexcept
+{
+	uint32_t table = 0;
+	for (unsigned int n = 0; n < 16; n++) {
+		const bool equal = n & 1, all = n & 2, none = n & 4,
+			   exclusive = n & 8;
+		bool matched = false;
+		switch (triggerMode) {
+		case MCR_TM_EQUAL:
+			matched = equal;
+			break;
+		case MCR_TM_ALL:
+			matched = all;
+			break;
+		case MCR_TM_NONE:
+			matched = none;
+			break;
+		case MCR_TM_EXCLUSIVE:
+			matched = exclusive;
+			break;
+		case MCR_TM_INEQUAL:
+			matched = !equal;
+			break;
+		case MCR_TM_MATCH:
+			matched = exclusive && !none;
+			break;
+		case MCR_TM_ANY:
+			matched = !none;
+			break;
+		case MCR_TM_EQUAL_OR_NONE:
+			matched = equal || none;
+			break;
+		case MCR_TM_SOME:
+			matched = exclusive && !none && !equal;
+			break;
+		default:
+			break;
+		}
+		table |= uint32_t(matched) << n;
+	}
+	return table;
+}
+}
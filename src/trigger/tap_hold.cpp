@@ -0,0 +1,213 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/tap_hold.h"
+#include "mcr/libmacro.h"
+
+namespace mcr
+{
+namespace
+{
+/*! Tap dispatched by a tap-hold.  Copies of nested or queued dispatch
+ *  keep the tap-hold, on any thread. */
+class TappedKey : public Key {
+    public:
+	const TapHold *tapHoldPtr;
+
+	TappedKey(const Key &tap, const TapHold *tapHold)
+		: Key(tap), tapHoldPtr(tapHold)
+	{
+	}
+	virtual Signal *copy(void *memory, size_t size) const override
+	{
+		return copyAs(*this, memory, size);
+	}
+};
+}
+
+TapHold::TapHold(Libmacro *libmacroPtr)
+	: Trigger()
+	, context(libmacroPtr)
+	, hold(libmacroPtr)
+{
+}
+
+TapHold::TapHold(const TapHold &other)
+	: Trigger(other)
+	, context(other.context)
+	, key(other.key)
+	, holdMillis(other.holdMillis)
+	, tap(other.tap)
+	, hold(other.hold)
+{
+}
+
+TapHold::~TapHold()
+{
+	uint64_t id;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		id = _timeoutId;
+		_timeoutId = 0;
+		_state = IDLE;
+	}
+	cancelTimeout(id);
+}
+
+TapHold &TapHold::operator=(const TapHold &other)
+{
+	if (&other == this)
+		return *this;
+	uint64_t id;
+	State state;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		id = _timeoutId;
+		_timeoutId = 0;
+		state = _state;
+		_state = IDLE;
+	}
+	/* Released with the old settings */
+	cancelTimeout(id);
+	if (state == HOLDING)
+		sendRelease();
+	Trigger::operator=(other);
+	context = other.context;
+	key = other.key;
+	holdMillis = other.holdMillis;
+	tap = other.tap;
+	hold = other.hold;
+	return *this;
+}
+
+bool TapHold::receive(Signal *signalPtr, unsigned int mods)
+{
+	int pressedKey;
+	mcr_ApplyValue apply;
+	if (!signalPtr || !signalPtr->keyPress(&pressedKey, &apply))
+		return false;
+	/* Tapping may dispatch this key again. */
+	if (pressedKey == tap.key) {
+		auto *tappedPtr = dynamic_cast<const TappedKey *>(signalPtr);
+		if (tappedPtr && tappedPtr->tapHoldPtr == this)
+			return false;
+	}
+	const bool releaseFlag = apply == MCR_UNSET || apply == MCR_BOTH;
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (pressedKey != key) {
+		if (_state != PENDING || apply == MCR_UNSET)
+			return false;
+		/* Another key while waiting resolves to hold. */
+		const uint64_t id = _timeoutId;
+		_timeoutId = 0;
+		_state = HOLDING;
+		lock.unlock();
+		cancelTimeout(id);
+		resolveHold(signalPtr, mods);
+		return false;
+	}
+	switch (_state) {
+	case IDLE:
+		if (apply == MCR_UNSET)
+			return false;
+		if (apply == MCR_BOTH) {
+			lock.unlock();
+			dispatchTap(signalPtr->source);
+			return true;
+		}
+		_timerPtr = &Libmacro::instance(context)->timer();
+		_timeoutId = _timerPtr->schedule(&_timeout, holdMillis);
+		_state = PENDING;
+		return true;
+	case PENDING:
+		/* Key repeat keeps waiting. */
+		if (releaseFlag) {
+			const uint64_t id = _timeoutId;
+			_timeoutId = 0;
+			_state = IDLE;
+			lock.unlock();
+			cancelTimeout(id);
+			dispatchTap(signalPtr->source);
+		}
+		return true;
+	case HOLDING:
+		if (releaseFlag) {
+			/* Released while the timeout is still resolving */
+			const uint64_t id = _timeoutId;
+			_timeoutId = 0;
+			_state = IDLE;
+			lock.unlock();
+			cancelTimeout(id);
+			sendRelease();
+		}
+		return true;
+	}
+	return false;
+}
+
+bool TapHold::pending() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _state == PENDING;
+}
+
+bool TapHold::holding() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _state == HOLDING;
+}
+
+bool TapHold::Timeout::act()
+{
+	uint64_t id;
+	{
+		std::lock_guard<std::mutex> lock(owner->_mutex);
+		/* Released or another key pressed first */
+		if (owner->_state != PENDING)
+			return false;
+		/* Keep the id until resolved, cancelling it waits for this. */
+		id = owner->_timeoutId;
+		owner->_state = HOLDING;
+	}
+	owner->resolveHold(nullptr,
+			   Libmacro::instance(owner->context)->modifiers());
+	std::lock_guard<std::mutex> lock(owner->_mutex);
+	if (owner->_timeoutId == id)
+		owner->_timeoutId = 0;
+	return false;
+}
+
+void TapHold::cancelTimeout(uint64_t id)
+{
+	/* Waits for the timeout if it is resolving now. */
+	if (id)
+		_timerPtr->cancel(id);
+}
+
+void TapHold::resolveHold(Signal *signalPtr, unsigned int mods)
+{
+	/* Sent now, dispatching from a receiver would be queued until after
+	 * the key resolving hold is sent. */
+	Modifier held = hold;
+	held.context = Libmacro::instance(context);
+	held.apply = MCR_SET;
+	held.send();
+	trigger(signalPtr, mods);
+}
+
+void TapHold::dispatchTap(size_t source)
+{
+	TappedKey tapped(tap, this);
+	tapped.source = source;
+	Libmacro::instance(context)->dispatch(&tapped);
+}
+
+void TapHold::sendRelease()
+{
+	Modifier released = hold;
+	released.context = Libmacro::instance(context);
+	released.apply = MCR_UNSET;
+	released.send();
+}
+}
@@ -0,0 +1,67 @@
+/* Libmacro - A multi-platform, extendable macro and hotkey C library
+  Copyright (C) 2013 Jonathan Pelletier, New Paradigm Software
+  SPDX-License-Identifier: LGPL-2.1-only */
+
+#include "mcr/trigger/throttle.h"
+#include "mcr/key_state.h"
+
+namespace mcr
+{
+Throttle::Throttle(const Throttle &other)
+	: Trigger(other)
+	, receiverPtr(other.receiverPtr)
+	, rate(other.rate)
+	, burst(other.burst)
+{
+}
+
+Throttle &Throttle::operator=(const Throttle &other)
+{
+	if (&other == this)
+		return *this;
+	Trigger::operator=(other);
+	receiverPtr = other.receiverPtr;
+	rate = other.rate;
+	burst = other.burst;
+	reset();
+	return *this;
+}
+
+bool Throttle::receive(Signal *signalPtr, unsigned int mods)
+{
+	if (!take())
+		return false;
+	if (receiverPtr)
+		return receiverPtr->receive(signalPtr, mods);
+	return trigger(signalPtr, mods);
+}
+
+bool Throttle::take() noexcept
+{
+	if (!rate) {
+		_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	/* Each token is one interval of credit.  The bucket holds burst
+	 * tokens, so the full time may be up to burst intervals ahead. */
+	const uint64_t interval = 1000000000 / rate;
+	const uint64_t capacity = interval * (burst ? burst : 1);
+	const uint64_t now = KeyState::now();
+	uint64_t fullTime = _fullTime.load(std::memory_order_relaxed);
+	uint64_t next;
+	do {
+		next = (fullTime > now ? fullTime : now) + interval;
+		if (next - now > capacity) {
+			_droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	} while (!_fullTime.compare_exchange_weak(fullTime, next,
+						  std::memory_order_relaxed));
+	return true;
+}
+
+void Throttle::reset() noexcept
+{
+	_fullTime.store(0, std::memory_order_relaxed);
+}
+}
@@ -5,28 +5,79 @@
 #include "taction.h"
 
 #include "expect_actor.h"
+#include "expect_receiver.h"
 #include "mcr/api.h"
 #include "mcr/inline.h"
 #include "mcr/libmacro.h"
 #include "mcr/factory.h"
+#include "mcr/signal/key.h"
+#include "mcr/signal/move_cursor.h"
 #include "mcr/signal/noop.h"
+#include "mcr/template/action.h"
 #include "mcr/trigger/action.h"
+#include "mcr/trigger/action_set.h"
+#include "mcr/trigger/chord.h"
+#include "mcr/trigger/gesture.h"
+#include "mcr/trigger/multi_tap.h"
+#include "mcr/trigger/sequence.h"
+#include "mcr/trigger/table.h"
+#include "mcr/trigger/tap_hold.h"
+#include "mcr/trigger/throttle.h"
 #include "mcr/types.h"
 
 #include <QRandomGenerator>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 static std::unique_ptr<mcr::Libmacro, mcr::Libmacro::Deleter> _ctx;
 
+/*! Keys sent, in order */
+struct SentKey {
+	int key;
+	mcr_ApplyValue apply;
+	/*! Modifiers of the context when sent */
+	unsigned int modifiers;
+	size_t source;
+};
+static std::vector<SentKey> _sentKeys;
+
+static void recordSend(const mcr::Key &keySignal)
+{
+	_sentKeys.push_back(
+		SentKey{keySignal.key, keySignal.apply, _ctx->modifiers(),
+			keySignal.source});
+}
+
+/*! Keys received, in order */
+struct KeyRecorder : public mcr::IReceive {
+	std::vector<std::pair<int, mcr_ApplyValue>> keys;
+
+	virtual bool receive(mcr::Signal *signalPtr, unsigned int) override
+	{
+		int key;
+		mcr_ApplyValue apply;
+		if (signalPtr->keyPress(&key, &apply))
+			keys.emplace_back(key, apply);
+		return false;
+	}
+};
+
 TEST_MAIN(TAction)
 
 void TAction::initTestCase()
 {
 	_ctx = mcr::factory::createContext(false);
 	_ctx->setEnabled(true);
+	/* No platform, keys are recorded */
+	mcr::Key::platformSend = recordSend;
 }
 
 void TAction::cleanupTestCase()
 {
+	mcr::Key::platformSend = nullptr;
 	_ctx->setEnabled(false);
 	_ctx.reset();
 }
@@ -93,6 +144,66 @@ void TAction::canMatchTriggerMode()
 	QVERIFY(!match(MCR_TM_ANY, 0, 0));
 	QVERIFY(!match(MCR_TM_ANY, 0, ~0));
 	QVERIFY(match(MCR_TM_ANY, 1, ~0));
+	// Match
+	QVERIFY(match(MCR_TM_MATCH, 3, 1));
+	QVERIFY(match(MCR_TM_MATCH, 3, 3));
+	QVERIFY(!match(MCR_TM_MATCH, 3, 4));
+	QVERIFY(!match(MCR_TM_MATCH, 3, 5));
+	QVERIFY(!match(MCR_TM_MATCH, 0, 0));
+	// Equal or none
+	QVERIFY(match(MCR_TM_EQUAL_OR_NONE, 3, 3));
+	QVERIFY(match(MCR_TM_EQUAL_OR_NONE, 3, 4));
+	QVERIFY(!match(MCR_TM_EQUAL_OR_NONE, 3, 1));
+	QVERIFY(match(MCR_TM_EQUAL_OR_NONE, 0, 0));
+	// Some
+	QVERIFY(match(MCR_TM_SOME, 3, 1));
+	QVERIFY(!match(MCR_TM_SOME, 3, 3));
+	QVERIFY(!match(MCR_TM_SOME, 3, 5));
+	QVERIFY(!match(MCR_TM_SOME, 3, 0));
+	// User modes never match
+	QVERIFY(!match(MCR_TM_USER, 0, 0));
+}
+
+template <mcr_TriggerMode Mode> static void matchTemplateAction()
+{
+	ExpectActor actor;
+	mcr::TAction<Mode> templateAction;
+	mcr::Action action;
+	mcr::NoOp sig;
+	templateAction.actorPtr = &actor;
+	action.triggerMode = Mode;
+	for (unsigned int lhs = 0; lhs < 0x10; lhs++) {
+		templateAction.modifiers = action.modifiers = lhs;
+		for (unsigned int rhs = 0; rhs < 0x10; rhs++) {
+			const bool expected = match(Mode, lhs, rhs);
+			QCOMPARE(templateAction.accepts(rhs), expected);
+			QCOMPARE(action.accepts(rhs), expected);
+			templateAction.receive(&sig, rhs);
+			QCOMPARE(actor.received, expected);
+			actor.reset();
+		}
+	}
+}
+
+void TAction::canMatchTemplateAction()
+{
+	static_assert(mcr::triggerModeMatch<MCR_TM_SOME>(3, 1),
+		      "Matching is constexpr");
+	matchTemplateAction<MCR_TM_EQUAL>();
+	matchTemplateAction<MCR_TM_ALL>();
+	matchTemplateAction<MCR_TM_NONE>();
+	matchTemplateAction<MCR_TM_EXCLUSIVE>();
+	matchTemplateAction<MCR_TM_INEQUAL>();
+	matchTemplateAction<MCR_TM_MATCH>();
+	matchTemplateAction<MCR_TM_ANY>();
+	matchTemplateAction<MCR_TM_EQUAL_OR_NONE>();
+	matchTemplateAction<MCR_TM_SOME>();
+	matchTemplateAction<MCR_TM_USER>();
+
+	/* Runtime actions of unknown modes never match */
+	mcr::Action action;
+	action.triggerMode = MCR_TM_USER + 3;
+	QVERIFY(!action.accepts(0));
 }
 
 void TAction::canFilterActions_data()
@@ -183,3 +294,781 @@ void TAction::canFilterActions()
 	action.receive(&sig, setModifier);
 	QCOMPARE(actor.received, expectDispatch);
 }
+
+void TAction::canMatchTriggerTable()
+{
+	/* Small flags, so modes see equal, subset and disjoint inputs */
+	uint32_t seed = 1;
+	auto next = [&seed]() {
+		seed = seed * 1103515245 + 12345;
+		return (seed >> 16) & 0x7;
+	};
+	mcr::TriggerTable table;
+	std::vector<unsigned int> modifiers, modes;
+	/* Not a multiple of any lane count */
+	for (size_t i = 0; i < 1003; i++) {
+		modifiers.push_back(next());
+		const unsigned int mode = i % (MCR_TM_USER + 3);
+		modes.push_back(mode <= MCR_TM_USER ?
+					mode :
+					MCR_TM_EXTENDED + mode - MCR_TM_USER - 1);
+		QCOMPARE(table.add(modifiers.back(), modes.back()), i);
+	}
+	mcr::Action action;
+	action.modifiers = MCR_SHIFT;
+	action.triggerMode = MCR_TM_ALL;
+	modifiers.push_back(action.modifiers);
+	modes.push_back(action.triggerMode);
+	QCOMPARE(table.add(action), modes.size() - 1);
+	QCOMPARE(table.size(), modes.size());
+	QCOMPARE(table.wordCount(), (modes.size() + 63) / 64);
+
+	std::vector<uint64_t> bits(table.wordCount());
+	for (unsigned int mods = 0; mods < 8; mods++) {
+		for (unsigned int incoming : {mods, mods | MCR_SHIFT}) {
+			table.match(incoming, bits.data());
+			for (size_t i = 0; i < modes.size(); i++) {
+				const bool bit = (bits[i / 64] >> (i % 64)) & 1;
+				QCOMPARE(bit, match(modes[i], modifiers[i],
+						    incoming));
+			}
+		}
+	}
+	/* Bits past the last row are clear */
+	QCOMPARE(bits.back() >> (modes.size() % 64), (uint64_t)0);
+	/* Matched in chunks, the same as all at once */
+	std::vector<uint64_t> chunk(3);
+	table.match(MCR_SHIFT | 3, bits.data());
+	for (size_t first = 0; first < table.wordCount(); first += 3) {
+		const size_t count =
+			std::min<size_t>(3, table.wordCount() - first);
+		table.match(MCR_SHIFT | 3, chunk.data(), first, count);
+		for (size_t i = 0; i < count; i++)
+			QCOMPARE(chunk[i], bits[first + i]);
+	}
+
+	table.set(0, 5, MCR_TM_EQUAL);
+	table.match(5, bits.data());
+	QVERIFY(bits[0] & 1);
+	QVERIFY_EXCEPTION_THROWN(table.set(table.size(), 0, MCR_TM_EQUAL),
+				 mcr::Error);
+	table.clear();
+	QCOMPARE(table.size(), (size_t)0);
+	QCOMPARE(table.wordCount(), (size_t)0);
+}
+
+void TAction::canTriggerChord()
+{
+	auto &registry = _ctx->triggerRegistry();
+	mcr::Trigger *allocated = registry.allocate("Chord");
+	QVERIFY(allocated);
+	QCOMPARE(allocated->name(), "Chord");
+	registry.deallocate(allocated);
+
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	ExpectActor actor;
+	mcr::Chord chord(_ctx.get());
+	/* Keys in different key state words */
+	mcr::Key j(36), k(100);
+	chord.addKey(j.key);
+	chord.addKey(k.key);
+	chord.addKey(k.key);
+	QCOMPARE(chord.keys().size(), (size_t)2);
+	QVERIFY(chord.hasKey(100));
+	QVERIFY(!chord.hasKey(37));
+	QVERIFY_EXCEPTION_THROWN(chord.addKey(MCR_KEY_STATE_COUNT),
+				 mcr::Error);
+	QVERIFY_EXCEPTION_THROWN(chord.addKey(-1), mcr::Error);
+	chord.actorPtr = &actor;
+	for (mcr::Key *keyPtr : {&j, &k}) {
+		keyPtr->dispatcherPtr = dispatcher.get();
+		keyPtr->dispatchFlag = true;
+		dispatcher->add(keyPtr, &chord);
+	}
+	auto press = [&](mcr::Key &key, mcr_ApplyValue apply) {
+		key.apply = apply;
+		_ctx->dispatch(&key);
+	};
+
+	press(j, MCR_SET);
+	QVERIFY(_ctx->keyState().pressed(j.key));
+	actor.notExpected();
+	press(k, MCR_SET);
+	QVERIFY(actor.received);
+	actor.reset();
+	/* Key repeat does not trigger again */
+	press(k, MCR_SET);
+	press(j, MCR_SET);
+	actor.notExpected();
+	press(k, MCR_UNSET);
+	QVERIFY(!_ctx->keyState().pressed(k.key));
+	actor.notExpected();
+	press(k, MCR_SET);
+	QVERIFY(actor.received);
+	actor.reset();
+
+	/* Pressed and released keys trigger every time */
+	press(k, MCR_UNSET);
+	press(k, MCR_BOTH);
+	QVERIFY(actor.received);
+	actor.reset();
+	QVERIFY(!_ctx->keyState().pressed(k.key));
+	press(k, MCR_BOTH);
+	QVERIFY(actor.received);
+	actor.reset();
+	press(j, MCR_UNSET);
+
+	/* Keys pressed too far apart */
+	chord.windowMillis = 1;
+	press(j, MCR_SET);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	press(k, MCR_SET);
+	actor.notExpected();
+	press(j, MCR_UNSET);
+	press(k, MCR_UNSET);
+
+	chord.removeKey(k.key);
+	QVERIFY(!chord.hasKey(k.key));
+	QCOMPARE(chord.keys(), std::vector<int>{j.key});
+	press(j, MCR_SET);
+	QVERIFY(actor.received);
+	press(j, MCR_UNSET);
+}
+
+void TAction::canTriggerSequence()
+{
+	auto &registry = _ctx->triggerRegistry();
+	mcr::Trigger *allocated = registry.allocate("Sequence");
+	QVERIFY(allocated);
+	registry.deallocate(allocated);
+
+	const int a = 30, b = 48, c = 46, other = 50, ignored = 200;
+	mcr::SequenceAutomaton automaton;
+	mcr::Sequence abc{a, b, c}, bc{b, c}, aa{a, a};
+	ExpectActor abcActor, bcActor, aaActor;
+	abc.actorPtr = &abcActor;
+	bc.actorPtr = &bcActor;
+	aa.actorPtr = &aaActor;
+	aaActor.blockingFlag = aa.blockingFlag = true;
+	automaton.add(&abc);
+	automaton.add(&bc);
+	automaton.add(&aa);
+	automaton.ignoreKey(ignored);
+	/* Start, a, ab, abc, b, bc and aa */
+	QCOMPARE(automaton.stateCount(), (size_t)7);
+	auto type = [&automaton](std::initializer_list<int> keys) {
+		bool blocked = false;
+		for (int key : keys) {
+			mcr::Key press(key, MCR_SET), release(key, MCR_UNSET);
+			blocked = automaton.receive(&press, 0);
+			automaton.receive(&release, 0);
+		}
+		return blocked;
+	};
+
+	/* Sequences ending together all trigger */
+	QVERIFY(!type({a, b, c}));
+	QVERIFY(abcActor.received);
+	QVERIFY(bcActor.received);
+	abcActor.reset();
+	bcActor.reset();
+	/* Overlapping, and blocking */
+	QVERIFY(type({a, a}));
+	QVERIFY(aaActor.received);
+	aaActor.reset();
+	QVERIFY(type({a}));
+	QVERIFY(aaActor.received);
+	aaActor.reset();
+	/* Other keys start again, ignored keys do not */
+	automaton.reset();
+	type({a, other, b, c});
+	abcActor.notExpected();
+	QVERIFY(bcActor.received);
+	bcActor.reset();
+	type({a, ignored, b, ignored, c});
+	QVERIFY(abcActor.received);
+	abcActor.reset();
+	bcActor.reset();
+	/* Auto-repeat of a held key is one press */
+	{
+		mcr::Key press(a, MCR_SET), release(a, MCR_UNSET);
+		QVERIFY(!automaton.receive(&press, 0));
+		QVERIFY(!automaton.receive(&press, 0));
+		QVERIFY(!automaton.receive(&press, 0));
+		aaActor.notExpected();
+		automaton.receive(&release, 0);
+		QVERIFY(type({a}));
+		QVERIFY(aaActor.received);
+		aaActor.reset();
+		automaton.reset();
+	}
+
+	/* Too slow */
+	abc.timeoutMillis = 1;
+	type({a, b});
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	type({c});
+	abcActor.notExpected();
+	QVERIFY(bcActor.received);
+	bcActor.reset();
+
+	/* Changed keys are compiled when invalidated */
+	automaton.remove(&aa);
+	bc.keys = {c, c};
+	automaton.invalidate();
+	type({other, a, a, c, c});
+	aaActor.notExpected();
+	abcActor.notExpected();
+	QVERIFY(bcActor.received);
+	mcr::Sequence outOfRange{MCR_KEY_STATE_COUNT};
+	QVERIFY_EXCEPTION_THROWN(automaton.add(&outOfRange), mcr::Error);
+	bcActor.reset();
+
+	/* Received alone, such as a macro trigger */
+	mcr::Sequence aab{a, a, b};
+	ExpectActor aabActor;
+	aab.actorPtr = &aabActor;
+	aab.blockingFlag = true;
+	auto typeAlone = [](mcr::Sequence &sequence,
+			    std::initializer_list<int> keys) {
+		bool blocked = false;
+		for (int key : keys) {
+			mcr::Key press(key, MCR_SET), release(key, MCR_UNSET);
+			blocked = sequence.receive(&press, 0);
+			sequence.receive(&release, 0);
+		}
+		return blocked;
+	};
+	QVERIFY(!typeAlone(aab, {a, a}));
+	aabActor.notExpected();
+	QVERIFY(typeAlone(aab, {b}));
+	QVERIFY(aabActor.received);
+	aabActor.reset();
+	/* Overlapping */
+	QVERIFY(typeAlone(aab, {a, a, a, b}));
+	QVERIFY(aabActor.received);
+	aabActor.reset();
+	/* Other keys start again, ignored keys do not */
+	typeAlone(aab, {a, other, a, b});
+	aabActor.notExpected();
+	QVERIFY(!typeAlone(aab, {a, a, c, b}));
+	aabActor.notExpected();
+	/* Auto-repeat of a held key is one press */
+	{
+		mcr::Key press(a, MCR_SET), release(a, MCR_UNSET);
+		mcr::Key pressB(b, MCR_SET);
+		aab.receive(&press, 0);
+		aab.receive(&press, 0);
+		aab.receive(&press, 0);
+		QVERIFY(!aab.receive(&pressB, 0));
+		aabActor.notExpected();
+		aab.receive(&release, 0);
+		aab.reset();
+	}
+	/* A copy matches on its own */
+	typeAlone(aab, {a, a});
+	mcr::Sequence copied(aab);
+	QVERIFY(!typeAlone(copied, {b}));
+	aabActor.notExpected();
+	QVERIFY(typeAlone(aab, {b}));
+	QVERIFY(aabActor.received);
+	aabActor.reset();
+	/* Changed keys */
+	aab.keys = {c};
+	QVERIFY(typeAlone(aab, {c}));
+	QVERIFY(aabActor.received);
+	aabActor.reset();
+	/* Too slow */
+	aab.keys = {a, b};
+	aab.timeoutMillis = 1;
+	typeAlone(aab, {a});
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	typeAlone(aab, {b});
+	aabActor.notExpected();
+}
+
+void TAction::canTriggerTapHold()
+{
+	auto &registry = _ctx->triggerRegistry();
+	mcr::Trigger *allocated = registry.allocate("TapHold");
+	QVERIFY(allocated);
+	registry.deallocate(allocated);
+
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	const int escape = 1;
+	ExpectActor actor;
+	KeyRecorder recorder;
+	mcr::Key capsLock(58), c(46);
+	mcr::TapHold tapHold(_ctx.get());
+	tapHold.key = capsLock.key;
+	tapHold.tap.key = escape;
+	tapHold.hold.modifiers = MCR_CTRL;
+	tapHold.actorPtr = &actor;
+	for (mcr::Signal *signalPtr : {(mcr::Signal *)&capsLock,
+				       (mcr::Signal *)&c,
+				       (mcr::Signal *)&tapHold.tap}) {
+		signalPtr->dispatcherPtr = dispatcher.get();
+		signalPtr->dispatchFlag = true;
+	}
+	dispatcher->add(nullptr, &tapHold);
+	dispatcher->add(nullptr, &recorder);
+	auto press = [&](mcr::Key &key, mcr_ApplyValue apply) {
+		key.apply = apply;
+		return _ctx->dispatch(&key);
+	};
+	_ctx->setModifiers(0);
+	_sentKeys.clear();
+
+	/* Tapped, key repeat keeps waiting */
+	capsLock.source = 3;
+	QVERIFY(press(capsLock, MCR_SET));
+	QVERIFY(tapHold.pending());
+	QCOMPARE(_ctx->timer().pendingCount(), (size_t)1);
+	QVERIFY(press(capsLock, MCR_SET));
+	QVERIFY(press(capsLock, MCR_UNSET));
+	QVERIFY(!tapHold.pending());
+	QCOMPARE(_ctx->timer().pendingCount(), (size_t)0);
+	QCOMPARE(recorder.keys.size(), (size_t)1);
+	QCOMPARE(recorder.keys[0].first, escape);
+	QCOMPARE(recorder.keys[0].second, MCR_BOTH);
+	QCOMPARE(_ctx->modifiers(), 0u);
+	actor.notExpected();
+	recorder.keys.clear();
+	/* The tap is sent from the same device, blocked presses are not */
+	QCOMPARE(_sentKeys.size(), (size_t)1);
+	QCOMPARE(_sentKeys[0].key, escape);
+	QCOMPARE(_sentKeys[0].apply, MCR_BOTH);
+	QCOMPARE(_sentKeys[0].source, (size_t)3);
+	_sentKeys.clear();
+	capsLock.source = 0;
+
+	/* Another key resolves hold, and is not blocked */
+	press(capsLock, MCR_SET);
+	QVERIFY(!press(c, MCR_SET));
+	QVERIFY(tapHold.holding());
+	QCOMPARE(_ctx->timer().pendingCount(), (size_t)0);
+	QCOMPARE(_ctx->modifiers(), (unsigned int)MCR_CTRL);
+	QVERIFY(actor.received);
+	actor.reset();
+	press(c, MCR_UNSET);
+	QVERIFY(press(capsLock, MCR_UNSET));
+	QVERIFY(!tapHold.holding());
+	QCOMPARE(_ctx->modifiers(), 0u);
+	QCOMPARE(recorder.keys.size(), (size_t)2);
+	QCOMPARE(recorder.keys[0].first, c.key);
+	QCOMPARE(recorder.keys[1].first, c.key);
+	recorder.keys.clear();
+	/* The interrupting key is sent with the hold modifiers */
+	QCOMPARE(_sentKeys.size(), (size_t)2);
+	QCOMPARE(_sentKeys[0].key, c.key);
+	QCOMPARE(_sentKeys[0].apply, MCR_SET);
+	QCOMPARE(_sentKeys[0].modifiers, (unsigned int)MCR_CTRL);
+	QCOMPARE(_sentKeys[1].key, c.key);
+	QCOMPARE(_sentKeys[1].modifiers, (unsigned int)MCR_CTRL);
+	_sentKeys.clear();
+
+	/* Timeout resolves hold on the timer thread */
+	tapHold.holdMillis = 5;
+	press(capsLock, MCR_SET);
+	for (int i = 0; i < 1000 && _ctx->modifiers() != MCR_CTRL; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	QVERIFY(tapHold.holding());
+	QCOMPARE(_ctx->modifiers(), (unsigned int)MCR_CTRL);
+	press(capsLock, MCR_UNSET);
+	QCOMPARE(_ctx->modifiers(), 0u);
+	QVERIFY(recorder.keys.empty());
+	QVERIFY(_sentKeys.empty());
+	actor.reset();
+
+	/* Tapping the dual-role key itself is not received again */
+	tapHold.tap.key = capsLock.key;
+	QVERIFY(press(capsLock, MCR_SET));
+	QVERIFY(press(capsLock, MCR_UNSET));
+	QVERIFY(!tapHold.pending());
+	QCOMPARE(_sentKeys.size(), (size_t)1);
+	QCOMPARE(_sentKeys[0].key, capsLock.key);
+	QCOMPARE(_sentKeys[0].apply, MCR_BOTH);
+	_sentKeys.clear();
+	recorder.keys.clear();
+	actor.notExpected();
+	tapHold.tap.key = escape;
+
+	/* Destroyed while waiting cancels the timeout */
+	{
+		mcr::TapHold waiting(tapHold);
+		waiting.holdMillis = 1000;
+		capsLock.apply = MCR_SET;
+		QVERIFY(waiting.receive(&capsLock, 0));
+		QCOMPARE(_ctx->timer().pendingCount(), (size_t)1);
+	}
+	QCOMPARE(_ctx->timer().pendingCount(), (size_t)0);
+
+	/* Assigned while waiting or holding resets */
+	{
+		mcr::TapHold assigned(tapHold);
+		assigned.holdMillis = 1000;
+		capsLock.apply = MCR_SET;
+		QVERIFY(assigned.receive(&capsLock, 0));
+		QCOMPARE(_ctx->timer().pendingCount(), (size_t)1);
+		assigned = tapHold;
+		QVERIFY(!assigned.pending());
+		QCOMPARE(_ctx->timer().pendingCount(), (size_t)0);
+		c.apply = MCR_SET;
+		QVERIFY(assigned.receive(&capsLock, 0));
+		QVERIFY(!assigned.receive(&c, 0));
+		QVERIFY(assigned.holding());
+		QCOMPARE(_ctx->modifiers(), (unsigned int)MCR_CTRL);
+		assigned = tapHold;
+		QVERIFY(!assigned.holding());
+		QCOMPARE(_ctx->modifiers(), 0u);
+		actor.reset();
+		_sentKeys.clear();
+	}
+	dispatcher->clear();
+}
+
+void TAction::canTriggerActionSet()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	mcr::Key key(30), other(31);
+	key.dispatcherPtr = other.dispatcherPtr = dispatcher.get();
+	ExpectActor actors[4];
+	mcr::Action actions[4];
+	/* Three identical predicates, and one other */
+	for (size_t i = 0; i < 4; i++) {
+		actions[i].modifiers = i < 3 ? MCR_CTRL : MCR_SHIFT;
+		actions[i].triggerMode = i < 3 ? MCR_TM_EQUAL : MCR_TM_NONE;
+		actions[i].actorPtr = &actors[i];
+	}
+	{
+		mcr::ActionSet set;
+		for (auto &action : actions)
+			set.add(&key, &action);
+		set.add(&key, &actions[0]);
+		QCOMPARE(set.nodeCount(), (size_t)2);
+		QCOMPARE(set.actionCount(), (size_t)4);
+		/* One receiver for all actions of the signal */
+		QCOMPARE(dispatcher->count(), (mcr_index_t)1);
+
+		QVERIFY(!dispatcher->dispatch(&key, MCR_CTRL));
+		for (auto &actor : actors) {
+			QVERIFY(actor.received);
+			actor.reset();
+		}
+		actions[3].blockingFlag = true;
+		QVERIFY(dispatcher->dispatch(&key, 0));
+		for (size_t i = 0; i < 3; i++)
+			actors[i].notExpected();
+		QVERIFY(actors[3].received);
+		actors[3].reset();
+		QVERIFY(!dispatcher->dispatch(&other, MCR_CTRL));
+		for (auto &actor : actors)
+			actor.notExpected();
+
+		/* Removing the last action of a node removes the node */
+		set.remove(&actions[0]);
+		set.remove(&actions[3]);
+		QCOMPARE(set.nodeCount(), (size_t)1);
+		QCOMPARE(set.actionCount(), (size_t)2);
+		QCOMPARE(dispatcher->count(), (mcr_index_t)1);
+		dispatcher->dispatch(&key, MCR_CTRL);
+		actors[0].notExpected();
+		QVERIFY(actors[1].received);
+		QVERIFY(actors[2].received);
+		actors[1].reset();
+		actors[2].reset();
+		set.add(&other, &actions[0]);
+		QCOMPARE(dispatcher->count(), (mcr_index_t)2);
+		/* Removing a group keeps the others registered, in order */
+		KeyRecorder after;
+		dispatcher->add(&other, &after);
+		actions[0].blockingFlag = true;
+		set.remove(&actions[1]);
+		set.remove(&actions[2]);
+		QCOMPARE(dispatcher->count(), (mcr_index_t)2);
+		QVERIFY(dispatcher->dispatch(&other, MCR_CTRL));
+		QVERIFY(actors[0].received);
+		QVERIFY(after.keys.empty());
+		actors[0].reset();
+		actions[0].blockingFlag = false;
+		dispatcher->remove(&after);
+	}
+	/* Destroyed sets leave the dispatcher */
+	QCOMPARE(dispatcher->count(), (mcr_index_t)0);
+
+	/* More nodes than matched at once on the stack */
+	std::vector<mcr::Action> many(300);
+	ExpectActor last;
+	{
+		mcr::ActionSet set;
+		for (size_t i = 0; i < many.size(); i++) {
+			many[i].modifiers = static_cast<unsigned int>(i);
+			many[i].triggerMode = MCR_TM_EQUAL;
+			set.add(&key, &many[i]);
+		}
+		many.back().actorPtr = &last;
+		QCOMPARE(set.nodeCount(), many.size());
+		dispatcher->dispatch(&key, 299);
+		QVERIFY(last.received);
+		last.reset();
+		dispatcher->dispatch(&key, 1);
+		last.notExpected();
+	}
+}
+
+void TAction::canThrottleTrigger()
+{
+	auto &registry = _ctx->triggerRegistry();
+	mcr::Trigger *allocated = registry.allocate("Throttle");
+	QVERIFY(allocated);
+	registry.deallocate(allocated);
+
+	ExpectActor actor;
+	mcr::Key wheel(30);
+	mcr::Throttle throttle(10, 3);
+	throttle.actorPtr = &actor;
+	throttle.blockingFlag = true;
+
+	/* A burst, and then over the rate */
+	for (int i = 0; i < 3; i++)
+		QVERIFY(throttle.receive(&wheel, 0));
+	QVERIFY(actor.received);
+	actor.reset();
+	QVERIFY(!throttle.receive(&wheel, 0));
+	actor.notExpected();
+	QCOMPARE(throttle.droppedCount(), (size_t)1);
+	/* One token per interval */
+	std::this_thread::sleep_for(std::chrono::milliseconds(150));
+	QVERIFY(throttle.receive(&wheel, 0));
+	QVERIFY(actor.received);
+	actor.reset();
+
+	/* Accepted events go to the receiver instead */
+	ExpectReceiver receiver;
+	receiver.blocking = true;
+	throttle.receiverPtr = &receiver;
+	throttle.reset();
+	QVERIFY(throttle.receive(&wheel, 0));
+	QCOMPARE(receiver.signalActual, &wheel);
+	actor.notExpected();
+
+	/* Copies start full */
+	mcr::Throttle copy(throttle);
+	QCOMPARE(copy.rate, 10u);
+	QCOMPARE(copy.receiverPtr, &receiver);
+	QVERIFY(copy.take());
+	QCOMPARE(copy.droppedCount(), (size_t)0);
+	copy.rate = 0;
+	QVERIFY(!copy.take());
+	QCOMPARE(copy.droppedCount(), (size_t)1);
+}
+
+void TAction::canTriggerMultiTap()
+{
+	auto &registry = _ctx->triggerRegistry();
+	mcr::Trigger *allocated = registry.allocate("MultiTap");
+	QVERIFY(allocated);
+	registry.deallocate(allocated);
+
+	ExpectActor actor;
+	mcr::Key shift(42), other(30);
+	mcr::MultiTap doubleTap(shift.key, 2);
+	doubleTap.actorPtr = &actor;
+	doubleTap.blockingFlag = true;
+	auto tap = [&](mcr::Key &key, mcr_ApplyValue apply) {
+		key.apply = apply;
+		return doubleTap.receive(&key, 0);
+	};
+
+	/* Key repeat and other keys are not taps */
+	QVERIFY(!tap(shift, MCR_SET));
+	QVERIFY(!tap(shift, MCR_SET));
+	QVERIFY(!tap(other, MCR_BOTH));
+	QCOMPARE(doubleTap.taps(), 1u);
+	QVERIFY(!tap(shift, MCR_UNSET));
+	actor.notExpected();
+	QVERIFY(tap(shift, MCR_SET));
+	QVERIFY(actor.received);
+	actor.reset();
+	QCOMPARE(doubleTap.taps(), 0u);
+	QVERIFY(!tap(shift, MCR_UNSET));
+
+	/* Pressed and released together, and starting again */
+	doubleTap.count = 3;
+	QVERIFY(!tap(shift, MCR_BOTH));
+	QVERIFY(!tap(shift, MCR_BOTH));
+	QVERIFY(tap(shift, MCR_BOTH));
+	QVERIFY(actor.received);
+	actor.reset();
+
+	/* Too slow starts counting again */
+	doubleTap.count = 2;
+	doubleTap.windowMillis = 1;
+	tap(shift, MCR_BOTH);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	QVERIFY(!tap(shift, MCR_BOTH));
+	actor.notExpected();
+	QCOMPARE(doubleTap.taps(), 1u);
+	QCOMPARE(doubleTap.resolvedTaps(), 3u);
+
+	/* A closed window triggers on the next event, with its taps */
+	doubleTap.count = 3;
+	doubleTap.windowMillis = 20;
+	doubleTap.windowCloseFlag = true;
+	doubleTap.reset();
+	QVERIFY(!tap(shift, MCR_BOTH));
+	QVERIFY(!tap(shift, MCR_BOTH));
+	QVERIFY(!doubleTap.resolve());
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	/* Other keys are not blocked for it */
+	QVERIFY(!tap(other, MCR_BOTH));
+	QVERIFY(actor.received);
+	actor.reset();
+	QCOMPARE(doubleTap.resolvedTaps(), 2u);
+	QCOMPARE(doubleTap.taps(), 0u);
+	/* Or by resolving, and the next tap counts again */
+	QVERIFY(!tap(shift, MCR_SET));
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	QVERIFY(doubleTap.resolve());
+	QVERIFY(actor.received);
+	actor.reset();
+	QCOMPARE(doubleTap.resolvedTaps(), 1u);
+	QVERIFY(!doubleTap.resolve());
+	QVERIFY(!tap(shift, MCR_SET));
+	actor.notExpected();
+	QCOMPARE(doubleTap.taps(), 0u);
+	QVERIFY(!tap(shift, MCR_UNSET));
+	QVERIFY(!tap(shift, MCR_BOTH));
+	QCOMPARE(doubleTap.taps(), 1u);
+	doubleTap.reset();
+	QCOMPARE(doubleTap.resolvedTaps(), 0u);
+
+	mcr::MultiTap copy(doubleTap);
+	QCOMPARE(copy.key, shift.key);
+	QCOMPARE(copy.taps(), 0u);
+	QVERIFY(copy.windowCloseFlag);
+	doubleTap.reset();
+	QCOMPARE(doubleTap.taps(), 0u);
+}
+
+void TAction::canRecognizeGesture()
+{
+	auto &registry = _ctx->triggerRegistry();
+	mcr::Trigger *allocated = registry.allocate("Gesture");
+	QVERIFY(allocated);
+	registry.deallocate(allocated);
+
+	QCOMPARE(mcr::GestureRecognizer::direction(10, 0), mcr::Gesture::EAST);
+	QCOMPARE(mcr::GestureRecognizer::direction(10, -3), mcr::Gesture::EAST);
+	QCOMPARE(mcr::GestureRecognizer::direction(0, 10), mcr::Gesture::SOUTH);
+	QCOMPARE(mcr::GestureRecognizer::direction(-10, -10),
+		 mcr::Gesture::NORTHWEST);
+
+	mcr::GestureRecognizer recognizer;
+	recognizer.stepDistance = 10;
+	recognizer.strokeSteps = 2;
+	mcr::Gesture swipe{mcr::Gesture::EAST},
+		square{mcr::Gesture::EAST, mcr::Gesture::SOUTH,
+		       mcr::Gesture::WEST, mcr::Gesture::NORTH},
+		flick{mcr::Gesture::NORTH};
+	flick.maxMillis = 50;
+	ExpectActor swipeActor, squareActor, flickActor;
+	swipe.actorPtr = &swipeActor;
+	square.actorPtr = &squareActor;
+	flick.actorPtr = &flickActor;
+	recognizer.add(&swipe);
+	recognizer.add(&square);
+	recognizer.add(&flick);
+	/* Start, E, ES, ESW, ESWN and N */
+	QCOMPARE(recognizer.stateCount(), (size_t)6);
+	/* The same direction twice cannot be stroked, and is not compiled */
+	mcr::Gesture twice{mcr::Gesture::SOUTH, mcr::Gesture::SOUTH};
+	recognizer.add(&twice);
+	QCOMPARE(recognizer.stateCount(), (size_t)6);
+	recognizer.remove(&twice);
+	uint64_t now = 0;
+	auto move = [&](long long dx, long long dy, int samples,
+			unsigned int millis) {
+		mcr::SpacePosition delta = NEW_mcr_SpacePosition;
+		delta.array[MCR_X] = dx;
+		delta.array[MCR_Y] = dy;
+		for (int i = 0; i < samples; i++) {
+			now += uint64_t(millis) * 1000000;
+			recognizer.sample(delta, true, now);
+		}
+	};
+
+	/* Small samples resample into steps, two steps are a stroke */
+	move(5, 0, 3, 1);
+	swipeActor.notExpected();
+	move(5, 0, 1, 1);
+	QVERIFY(swipeActor.received);
+	swipeActor.reset();
+	/* Continuing a stroke does not trigger again */
+	move(5, 0, 8, 1);
+	swipeActor.notExpected();
+
+	/* Strokes in order, too slow to flick */
+	move(0, 10, 2, 60);
+	move(-10, 0, 2, 60);
+	move(0, -10, 2, 60);
+	QVERIFY(squareActor.received);
+	squareActor.reset();
+	flickActor.notExpected();
+
+	/* Pausing starts again */
+	move(10, 0, 1, 300);
+	move(10, 0, 1, 1);
+	QVERIFY(swipeActor.received);
+	swipeActor.reset();
+	move(0, 10, 2, 1);
+	move(-10, 0, 2, 1);
+	move(0, -10, 1, 300);
+	move(0, -10, 1, 1);
+	squareActor.notExpected();
+	QVERIFY(flickActor.received);
+	flickActor.reset();
+
+	/* Motion signals, absolute from the first position */
+	recognizer.reset();
+	mcr::MoveCursor cursor(100, 100, false);
+	QVERIFY(!recognizer.receive(&cursor, 0));
+	cursor.position.array[MCR_X] = 130;
+	recognizer.receive(&cursor, 0);
+	QVERIFY(swipeActor.received);
+	swipeActor.reset();
+	mcr::Key key(30);
+	QVERIFY(!recognizer.receive(&key, 0));
+
+	/* Motion left over from a step counts toward the next */
+	move(15, 0, 1, 300);
+	swipeActor.notExpected();
+	move(5, 0, 1, 1);
+	QVERIFY(swipeActor.received);
+	swipeActor.reset();
+
+	/* Received alone, such as a macro trigger */
+	mcr::Gesture alone{mcr::Gesture::SOUTH};
+	ExpectActor aloneActor;
+	alone.actorPtr = &aloneActor;
+	alone.blockingFlag = true;
+	mcr::MoveCursor down(0, MCR_GESTURE_STEP * MCR_GESTURE_STROKE_STEPS);
+	QVERIFY(alone.receive(&down, 0));
+	QVERIFY(aloneActor.received);
+	aloneActor.reset();
+	QVERIFY(!alone.receive(&key, 0));
+	/* Changed strokes, and a copy recognizes on its own */
+	alone.setStrokes({mcr::Gesture::WEST});
+	mcr::Gesture copied(alone);
+	mcr::MoveCursor left(-MCR_GESTURE_STEP * MCR_GESTURE_STROKE_STEPS, 0);
+	QVERIFY(!alone.receive(&down, 0));
+	QVERIFY(alone.receive(&left, 0));
+	QVERIFY(aloneActor.received);
+	aloneActor.reset();
+	QVERIFY(copied.receive(&left, 0));
+	QVERIFY(aloneActor.received);
+	aloneActor.reset();
+}
@@ -26,4 +26,13 @@ class TAction : public QObject {
 	void canMatchTriggerMode();
 	void canFilterActions_data();
 	void canFilterActions();
+	void canMatchTriggerTable();
+	void canMatchTemplateAction();
+	void canTriggerChord();
+	void canTriggerSequence();
+	void canTriggerTapHold();
+	void canTriggerActionSet();
+	void canThrottleTrigger();
+	void canTriggerMultiTap();
+	void canRecognizeGesture();
 };
@@ -5,13 +5,27 @@
 #include "tdispatcher.h"
 
 #include <qtestcase.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "expect_receiver.h"
 #include "mcr/api.h"
 #include "mcr/libmacro.h"
 #include "mcr/factory.h"
+#include "mcr/signal/functor.h"
+#include "mcr/signal/key.h"
+#include "mcr/signal/modifier.h"
+#include "mcr/signal/move_cursor.h"
 #include "mcr/signal/noop.h"
+#include "mcr/template/dispatcher.h"
+#include "mcr/trigger/action.h"
 #include "mcr/types.h"
 
 static std::unique_ptr<mcr::Libmacro, mcr::Libmacro::Deleter> _ctx;
@@ -21,10 +35,13 @@ TEST_MAIN(TDispatcher)
 void TDispatcher::initTestCase()
 {
 	_ctx = mcr::factory::createContext(false);
+	/* No platform, keys are sent nowhere */
+	mcr::Key::platformSend = [](const mcr::Key &) {};
 }
 
 void TDispatcher::cleanupTestCase()
 {
+	mcr::Key::platformSend = nullptr;
 	_ctx.reset();
 }
 
@@ -101,7 +118,921 @@ void TDispatcher::canReceive()
 	QVERIFY(!blocked);
 }
 
+void TDispatcher::canIndexBySignal()
+{
+	auto dispatcher = _ctx->genericDispatcher();
+	TestReceiver noopRecv, ctrlRecv, genericRecv;
+	mcr::NoOp noop;
+	mcr::Modifier ctrl(_ctx.get()), shift(_ctx.get());
+	ctrl.modifiers = MCR_CTRL;
+	shift.modifiers = MCR_SHIFT;
+
+	dispatcher->add(&noop, &noopRecv);
+	dispatcher->add(&ctrl, &ctrlRecv);
+	dispatcher->add(nullptr, &genericRecv);
+	QCOMPARE(dispatcher->count(), 3);
+
+	dispatcher->dispatch(&noop, 0);
+	QVERIFY(noopRecv.received);
+	QVERIFY(!ctrlRecv.received);
+	QVERIFY(genericRecv.received);
+	noopRecv.reset();
+	genericRecv.reset();
+
+	dispatcher->dispatch(&shift, 0);
+	QVERIFY(!noopRecv.received);
+	QVERIFY(!ctrlRecv.received);
+	QVERIFY(genericRecv.received);
+	genericRecv.reset();
+
+	dispatcher->dispatch(&ctrl, 0);
+	QVERIFY(!noopRecv.received);
+	QVERIFY(ctrlRecv.received);
+	QCOMPARE(ctrlRecv.signalActual, &ctrl);
+	QVERIFY(genericRecv.received);
+
+	/* Removing one signal keeps the others of the receiver */
+	ctrlRecv.reset();
+	genericRecv.reset();
+	dispatcher->add(&noop, &ctrlRecv);
+	QCOMPARE(dispatcher->count(), 4);
+	QVERIFY(dispatcher->remove(&noop, &ctrlRecv));
+	QCOMPARE(dispatcher->count(), 3);
+	dispatcher->dispatch(&noop, 0);
+	QVERIFY(!ctrlRecv.received);
+	dispatcher->dispatch(&ctrl, 0);
+	QVERIFY(ctrlRecv.received);
+	QVERIFY(dispatcher->remove(nullptr, &genericRecv));
+	QCOMPARE(dispatcher->count(), 2);
+
+	dispatcher->remove(&ctrlRecv);
+	QCOMPARE(dispatcher->count(), 1);
+	dispatcher->clear();
+	QVERIFY(dispatcher->empty());
+}
+
+void TDispatcher::canDispatchWhileModified()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	TestReceiver recv[8];
+	mcr::NoOp sig;
+	std::atomic<bool> running{true};
+
+	std::thread dispatchThread([&]() {
+		while (running)
+			dispatcher->dispatch(&sig, 0);
+	});
+	for (int i = 0; i < 1000; i++) {
+		for (auto &iter : recv)
+			dispatcher->add(&sig, &iter);
+		for (auto &iter : recv)
+			dispatcher->remove(&iter);
+	}
+	running = false;
+	dispatchThread.join();
+	QVERIFY(dispatcher->empty());
+}
+
+namespace
+{
+struct OrderReceiver final : public mcr::IReceive {
+	std::vector<int> *order = nullptr;
+	int id = 0;
+	bool blocking = false;
+
+	virtual bool receive(mcr::Signal *, unsigned int) override
+	{
+		order->push_back(id);
+		return blocking;
+	}
+};
+}
+
+void TDispatcher::canDispatchInPriorityOrder()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	std::vector<int> order;
+	OrderReceiver recv[4];
+	mcr::NoOp sig;
+	for (int i = 0; i < 4; i++) {
+		recv[i].order = &order;
+		recv[i].id = i;
+	}
+
+	dispatcher->add(&sig, &recv[0]);
+	dispatcher->add(&sig, &recv[1], 5);
+	dispatcher->add(nullptr, &recv[2]);
+	dispatcher->add(nullptr, &recv[3], 5);
+	dispatcher->dispatch(&sig, 0);
+	QCOMPARE(order, std::vector<int>({ 1, 3, 0, 2 }));
+
+	order.clear();
+	recv[0].blocking = true;
+	QVERIFY(dispatcher->dispatch(&sig, 0));
+	QCOMPARE(order, std::vector<int>({ 1, 3, 0 }));
+
+	/* Re-adding changes priority without duplicating */
+	order.clear();
+	dispatcher->add(&sig, &recv[0], 10);
+	QCOMPARE(dispatcher->count(), 4);
+	QVERIFY(dispatcher->dispatch(&sig, 0));
+	QCOMPARE(order, std::vector<int>({ 0 }));
+}
+
+void TDispatcher::canDispatchBatch()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	TestReceiver recv;
+	mcr::NoOp noop;
+	mcr::Modifier ctrl(_ctx.get());
+	ctrl.modifiers = MCR_CTRL;
+	mcr::Signal *frame[] = { &noop, nullptr, &ctrl, &noop };
+	bool blocked[mcr_arrlen(frame)];
+
+	dispatcher->add(&ctrl, &recv);
+	recv.blocking = true;
+	dispatcher->dispatchBatch(frame, mcr_arrlen(frame), 0, blocked);
+	QVERIFY(!blocked[0]);
+	QVERIFY(!blocked[1]);
+	QVERIFY(blocked[2]);
+	QVERIFY(!blocked[3]);
+	QCOMPARE(recv.signalActual, &ctrl);
+
+	recv.reset();
+	dispatcher->dispatchBatch(frame, 2, 0, nullptr);
+	QVERIFY(!recv.received);
+}
+
+namespace
+{
+struct SlowReceiver final : public mcr::IReceive {
+	std::atomic<int> startedCount{0};
+	std::atomic<int> receivedCount{0};
+	std::atomic<bool> slow{false};
+	bool blocking = false;
+	std::thread::id threadId;
+	/*! Removed after receiving, if set */
+	std::atomic<mcr::IDispatcher *> removeFrom{nullptr};
+	mcr::IReceive *removePtr = nullptr;
+
+	virtual bool receive(mcr::Signal *, unsigned int) override
+	{
+		++startedCount;
+		threadId = std::this_thread::get_id();
+		if (slow)
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds(20));
+		if (mcr::IDispatcher *dispatcherPtr = removeFrom)
+			dispatcherPtr->remove(removePtr);
+		++receivedCount;
+		return blocking;
+	}
+};
+}
+
+void TDispatcher::canDispatchOnQueue()
+{
+	auto target =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	auto queue = mcr::factory::createDispatchQueue(target.get(), 3);
+	SlowReceiver recv;
+	mcr::NoOp sig;
+
+	QCOMPARE(queue->target(), target.get());
+	QCOMPARE(queue->capacity(), (size_t)4);
+	queue->add(&sig, &recv);
+	QCOMPARE(target->count(), 1);
+
+	/* Blocking decision is made on the dispatch thread. */
+	queue->setDeadline(1000000);
+	recv.blocking = true;
+	QVERIFY(queue->dispatch(&sig, 0));
+	QCOMPARE(recv.receivedCount.load(), 1);
+	QVERIFY(recv.threadId != std::this_thread::get_id());
+
+	/* Slow receivers pass through after the deadline. */
+	queue->setDeadline(1000);
+	recv.slow = true;
+	QVERIFY(!queue->dispatch(&sig, 0));
+	QCOMPARE(queue->expiredCount(), (size_t)1);
+
+	/* No deadline never waits, receivers still receive. */
+	queue->setDeadline(0);
+	recv.slow = false;
+	QVERIFY(!queue->dispatch(&sig, 0));
+	for (int i = 0; i < 1000 && recv.receivedCount < 3; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	QCOMPARE(recv.receivedCount.load(), 3);
+
+	queue->remove(&recv);
+	QVERIFY(queue->empty());
+}
+
+void TDispatcher::canDispatchAndSend()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	auto generic = _ctx->genericDispatcher();
+	TestReceiver recv, genericRecv;
+	int sendCount = 0;
+	mcr::FunctorSignal sig([&sendCount]() { ++sendCount; });
+	sig.dispatcherPtr = dispatcher.get();
+	dispatcher->add(&sig, &recv);
+	generic->add(nullptr, &genericRecv);
+
+	/* Dispatch disabled, only sent */
+	QVERIFY(!_ctx->dispatch(&sig));
+	QCOMPARE(sendCount, 1);
+	QVERIFY(!recv.received);
+
+	sig.dispatchFlag = true;
+	_ctx->setGenericDispatchFlag(false);
+	QVERIFY(!_ctx->dispatch(&sig));
+	QCOMPARE(sendCount, 2);
+	QVERIFY(recv.received);
+	QVERIFY(!genericRecv.received);
+
+	recv.reset();
+	_ctx->setGenericDispatchFlag(true);
+	genericRecv.blocking = true;
+	QVERIFY(_ctx->dispatch(&sig));
+	QCOMPARE(sendCount, 2);
+	QVERIFY(recv.received);
+	QVERIFY(genericRecv.received);
+
+	recv.reset();
+	genericRecv.reset();
+	recv.blocking = true;
+	QVERIFY(_ctx->dispatch(&sig));
+	QVERIFY(!genericRecv.received);
+
+	_ctx->setGenericDispatchFlag(false);
+	generic->clear();
+
+	/* Keys are sent by the platform only */
+	static int keySendCount;
+	auto platformSend = mcr::Key::platformSend;
+	mcr::Key key(30);
+	mcr::Key::platformSend = [](const mcr::Key &) { ++keySendCount; };
+	QVERIFY(!_ctx->dispatch(&key));
+	QCOMPARE(keySendCount, 1);
+	mcr::Key::platformSend = nullptr;
+	QVERIFY_EXCEPTION_THROWN(key.send(), mcr::Error);
+	mcr::Key::platformSend = platformSend;
+
+	/* So is motion */
+	static int moveSendCount;
+	mcr::MoveCursor cursor(1, 2);
+	mcr::MoveCursor::platformSend = [](const mcr::MoveCursor &) {
+		++moveSendCount;
+	};
+	QVERIFY(!_ctx->dispatch(&cursor));
+	QCOMPARE(moveSendCount, 1);
+	mcr::MoveCursor::platformSend = nullptr;
+	QVERIFY_EXCEPTION_THROWN(cursor.send(), mcr::Error);
+}
+
+void TDispatcher::canCountUnreceived()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	TestReceiver recv;
+	mcr::Modifier ctrl(_ctx.get()), shift(_ctx.get());
+	ctrl.modifiers = MCR_CTRL;
+	shift.modifiers = MCR_SHIFT;
+
+	QVERIFY(!dispatcher->dispatch(&ctrl, 0));
+	QCOMPARE(dispatcher->unreceivedCount(), (size_t)1);
+
+	dispatcher->add(&ctrl, &recv);
+	QVERIFY(!dispatcher->dispatch(&shift, 0));
+	QVERIFY(!recv.received);
+	QCOMPARE(dispatcher->unreceivedCount(), (size_t)2);
+
+	QVERIFY(!dispatcher->dispatch(&ctrl, 0));
+	QVERIFY(recv.received);
+	QCOMPARE(dispatcher->unreceivedCount(), (size_t)2);
+
+	/* Generic receivers receive everything */
+	dispatcher->add(nullptr, &recv);
+	QVERIFY(!dispatcher->dispatch(&shift, 0));
+	QCOMPARE(dispatcher->unreceivedCount(), (size_t)2);
+}
+
+struct ModifierReceiver final
+	: public mcr::TReceive<mcr::Modifier, ModifierReceiver> {
+	std::vector<int> *orderPtr = nullptr;
+	int id = 0;
+	bool blocking = false;
+
+	ModifierReceiver(std::vector<int> *orderPtr = nullptr, int id = 0)
+		: orderPtr(orderPtr)
+		, id(id)
+	{
+	}
+	bool receiveSignal(mcr::Modifier &, unsigned int)
+	{
+		if (orderPtr)
+			orderPtr->push_back(id);
+		return blocking;
+	}
+};
+
+void TDispatcher::canDispatchTyped()
+{
+	mcr::TDispatcher<mcr::Modifier, ModifierReceiver> dispatcher;
+	std::vector<int> order;
+	ModifierReceiver first(&order, 1), second(&order, 2),
+		generic(&order, 3);
+	mcr::Modifier ctrl(_ctx.get()), shift(_ctx.get());
+	mcr::NoOp noop;
+	ctrl.modifiers = MCR_CTRL;
+	shift.modifiers = MCR_SHIFT;
+
+	dispatcher.add(&ctrl, &first);
+	dispatcher.add(&ctrl, &second, 1);
+	dispatcher.add(nullptr, &generic);
+	QCOMPARE(dispatcher.count(), (mcr_index_t)3);
+
+	QVERIFY(!dispatcher.dispatch(ctrl, 0));
+	QCOMPARE(order, std::vector<int>({2, 1, 3}));
+	order.clear();
+	QVERIFY(!dispatcher.dispatch(shift, 0));
+	QCOMPARE(order, std::vector<int>({3}));
+	order.clear();
+
+	/* Generic path through IDispatcher */
+	mcr::IDispatcher &base = dispatcher;
+	second.blocking = true;
+	QVERIFY(base.dispatch(&ctrl, 0));
+	QCOMPARE(order, std::vector<int>({2}));
+	order.clear();
+	QVERIFY(!base.dispatch(&noop, 0));
+	QVERIFY(order.empty());
+	QVERIFY_EXCEPTION_THROWN(base.add(&noop, &first), mcr::Error);
+
+	/* Typed receivers also receive from the generic dispatcher */
+	auto generic2 =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	generic2->add(&shift, &first);
+	QVERIFY(!generic2->dispatch(&shift, 0));
+	QVERIFY(!generic2->dispatch(&noop, 0));
+	QCOMPARE(order, std::vector<int>({1}));
+	order.clear();
+
+	dispatcher.remove(&second);
+	QCOMPARE(dispatcher.count(), (mcr_index_t)2);
+	QVERIFY(!base.dispatch(&ctrl, 0));
+	QCOMPARE(order, std::vector<int>({1, 3}));
+	order.clear();
+	QVERIFY(base.remove(&ctrl, &first));
+	QCOMPARE(dispatcher.count(), (mcr_index_t)1);
+	QVERIFY(!base.dispatch(&ctrl, 0));
+	QCOMPARE(order, std::vector<int>({3}));
+}
+
+namespace
+{
+struct SourceReceiver final : public mcr::IReceive {
+	std::mutex mutex;
+	/*! Signals are copied, so received by id */
+	std::map<size_t, std::vector<int>> received;
+	std::map<size_t, std::thread::id> threads;
+	int receivedCount = 0;
+
+	virtual bool receive(mcr::Signal *signalPtr, unsigned int) override
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		received[signalPtr->source].push_back(
+			static_cast<mcr::NoOp *>(signalPtr)->milliseconds);
+		threads[signalPtr->source] = std::this_thread::get_id();
+		++receivedCount;
+		return false;
+	}
+};
+}
+
+void TDispatcher::canDispatchSharded()
+{
+	auto target =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	auto sharded = mcr::factory::createShardedDispatcher(target.get(), 2);
+	SourceReceiver recv;
+	mcr::NoOp signals[2][8];
+
+	QCOMPARE(sharded->target(), target.get());
+	QCOMPARE(sharded->shardCount(), (size_t)2);
+	QVERIFY_EXCEPTION_THROWN(sharded->shard(2), mcr::Error);
+	sharded->add(nullptr, &recv);
+	QCOMPARE(target->count(), 1);
+
+	/* Devices dispatch asynchronously, alternating */
+	sharded->setDeadline(0);
+	for (size_t i = 0; i < 8; i++) {
+		for (size_t source = 0; source < 2; source++) {
+			signals[source][i].source = source;
+			signals[source][i].milliseconds = static_cast<int>(i);
+			QVERIFY(!sharded->dispatch(&signals[source][i], 0));
+		}
+	}
+	for (int i = 0; i < 1000; i++) {
+		{
+			std::lock_guard<std::mutex> lock(recv.mutex);
+			if (recv.receivedCount == 16)
+				break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::lock_guard<std::mutex> lock(recv.mutex);
+	QCOMPARE(recv.receivedCount, 16);
+	QVERIFY(sharded->shardOf(&signals[0][0]) !=
+		sharded->shardOf(&signals[1][0]));
+	QVERIFY(recv.threads[0] != recv.threads[1]);
+	for (size_t source = 0; source < 2; source++) {
+		/* Each device is received in order */
+		QCOMPARE(recv.received[source].size(), (size_t)8);
+		for (size_t i = 0; i < 8; i++)
+			QCOMPARE(recv.received[source][i], (int)i);
+	}
+}
+
+void TDispatcher::canRecordDispatch()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	TestReceiver recv;
+	mcr::Modifier ctrl(_ctx.get()), shift(_ctx.get());
+	mcr::DispatchRecord records[MCR_DISPATCH_RECORD_COUNT];
+	ctrl.modifiers = MCR_CTRL;
+	shift.modifiers = MCR_SHIFT;
+	recv.blocking = true;
+	dispatcher->add(&ctrl, &recv);
+
+	/* Not recorded by default */
+	QVERIFY(!dispatcher->recordFlag());
+	QVERIFY(dispatcher->dispatch(&ctrl, 0));
+	QCOMPARE(dispatcher->snapshot(records, MCR_DISPATCH_RECORD_COUNT),
+		 (size_t)0);
+
+	dispatcher->setRecordFlag(true);
+	QVERIFY(!dispatcher->dispatch(&shift, MCR_ALT));
+	QVERIFY(dispatcher->dispatch(&ctrl, 0));
+	QCOMPARE(dispatcher->snapshot(records, MCR_DISPATCH_RECORD_COUNT),
+		 (size_t)2);
+	QCOMPARE(std::string(records[0].signalName), std::string("Modifier"));
+	QCOMPARE(records[0].key, (size_t)MCR_SHIFT);
+	QCOMPARE(records[0].mods, (unsigned int)MCR_ALT);
+	QVERIFY(!records[0].blockingReceiverPtr);
+	QCOMPARE(records[1].key, (size_t)MCR_CTRL);
+	QCOMPARE(records[1].blockingReceiverPtr, (mcr::IReceive *)&recv);
+	QVERIFY(records[0].timestamp <= records[1].timestamp);
+
+	/* Only the most recent */
+	QCOMPARE(dispatcher->snapshot(records, 1), (size_t)1);
+	QCOMPARE(records[0].key, (size_t)MCR_CTRL);
+
+	/* Oldest are overwritten */
+	for (int i = 0; i < MCR_DISPATCH_RECORD_COUNT; i++)
+		dispatcher->dispatch(&shift, 0);
+	QCOMPARE(dispatcher->snapshot(records, MCR_DISPATCH_RECORD_COUNT),
+		 (size_t)MCR_DISPATCH_RECORD_COUNT);
+	QCOMPARE(records[0].key, (size_t)MCR_SHIFT);
+}
+
+void TDispatcher::canQuarantineSlowReceivers()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	SlowReceiver slow, fast;
+	mcr::ReceiverStats stats;
+	mcr::NoOp sig;
+	dispatcher->add(&sig, &slow, 1);
+	dispatcher->add(&sig, &fast);
+
+	/* Not timed by default */
+	QVERIFY(!dispatcher->statsFlag());
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QVERIFY(dispatcher->receiverStats(&slow, &stats));
+	QCOMPARE(stats.callCount, (uint64_t)0);
+	QVERIFY(!dispatcher->receiverStats(nullptr, &stats));
+
+	dispatcher->setStatsFlag(true);
+	slow.blocking = true;
+	QVERIFY(dispatcher->dispatch(&sig, 0));
+	QVERIFY(dispatcher->receiverStats(&slow, &stats));
+	QCOMPARE(stats.callCount, (uint64_t)1);
+	QCOMPARE(stats.blockCount, (uint64_t)1);
+	QVERIFY(stats.maxNanos <= stats.totalNanos);
+	QVERIFY(!stats.quarantinedFlag);
+
+	/* Exceed the budget once, then receive on the lane without
+	 * blocking. */
+	dispatcher->setQuarantineMicros(1000);
+	slow.slow = true;
+	QVERIFY(dispatcher->dispatch(&sig, 0));
+	QVERIFY(dispatcher->receiverStats(&slow, &stats));
+	QVERIFY(stats.quarantinedFlag);
+	QVERIFY(stats.maxNanos >= 1000000);
+	QCOMPARE(slow.threadId, std::this_thread::get_id());
+
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QCOMPARE(fast.receivedCount.load(), 2);
+	for (int i = 0; i < 1000 && slow.receivedCount < 4; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	QCOMPARE(slow.receivedCount.load(), 4);
+	QVERIFY(slow.threadId != std::this_thread::get_id());
+
+	/* Removing does not wait for the lane, which may remove receivers,
+	 * and skips its waiting signals. */
+	slow.removePtr = &fast;
+	slow.removeFrom = dispatcher.get();
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	for (int i = 0; i < 1000 && slow.startedCount < 5; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	dispatcher->remove(&slow);
+	for (int i = 0; i < 1000 && slow.receivedCount < 5; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	QCOMPARE(slow.startedCount.load(), 5);
+	QCOMPARE(slow.receivedCount.load(), 5);
+	dispatcher->clear();
+	QVERIFY(dispatcher->empty());
+	QVERIFY(!dispatcher->receiverStats(&slow, &stats));
+}
+
+void TDispatcher::canModifyByKey()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	TestReceiver recv;
+	mcr::Key hyper(0x2ff, MCR_SET), other(0x2fe, MCR_SET);
+	unsigned int mods = MCR_SHIFT;
+	dispatcher->setKeyModifiers(hyper.key, MCR_HYPER);
+	QCOMPARE(dispatcher->keyModifiers(hyper.key), (unsigned int)MCR_HYPER);
+	QCOMPARE(dispatcher->keyModifiers(-1), 0u);
+	QVERIFY_EXCEPTION_THROWN(
+		dispatcher->setKeyModifiers(MCR_KEY_MODIFIER_COUNT, MCR_CTRL),
+		mcr::Error);
+
+	QVERIFY(!dispatcher->dispatchAndModify(&hyper, &mods));
+	QCOMPARE(mods, (unsigned int)(MCR_SHIFT | MCR_HYPER));
+	QVERIFY(!dispatcher->dispatchAndModify(&other, &mods));
+	QCOMPARE(mods, (unsigned int)(MCR_SHIFT | MCR_HYPER));
+	hyper.apply = MCR_UNSET;
+	QVERIFY(!dispatcher->dispatchAndModify(&hyper, &mods));
+	QCOMPARE(mods, (unsigned int)MCR_SHIFT);
+	hyper.apply = MCR_TOGGLE;
+	QVERIFY(!dispatcher->dispatchAndModify(&hyper, &mods));
+	QCOMPARE(mods, (unsigned int)(MCR_SHIFT | MCR_HYPER));
+	hyper.apply = MCR_BOTH;
+	QVERIFY(!dispatcher->dispatchAndModify(&hyper, &mods));
+	QCOMPARE(mods, (unsigned int)MCR_SHIFT);
+
+	/* Blocked keys do not modify */
+	recv.blocking = true;
+	dispatcher->add(&hyper, &recv);
+	hyper.apply = MCR_SET;
+	QVERIFY(dispatcher->dispatchAndModify(&hyper, &mods));
+	QCOMPARE(mods, (unsigned int)MCR_SHIFT);
+
+	/* Libmacro modifiers follow dispatched keys */
+	auto generic = _ctx->genericDispatcher();
+	generic->setKeyModifiers(other.key, MCR_SUPER);
+	_ctx->setModifiers(0);
+	_ctx->setGenericDispatchFlag(true);
+	other.dispatchFlag = true;
+	QVERIFY(!_ctx->dispatch(&other));
+	QCOMPARE(_ctx->modifiers(), (unsigned int)MCR_SUPER);
+	other.apply = MCR_UNSET;
+	QVERIFY(!_ctx->dispatch(&other));
+	QCOMPARE(_ctx->modifiers(), 0u);
+	generic->setKeyModifiers(other.key, 0);
+}
+
+namespace
+{
+struct RemovingReceiver final : public mcr::IReceive {
+	mcr::IDispatcher *dispatcherPtr = nullptr;
+	mcr::IReceive *removePtr = nullptr;
+	int receivedCount = 0;
+
+	virtual bool receive(mcr::Signal *, unsigned int) override
+	{
+		++receivedCount;
+		if (removePtr)
+			dispatcherPtr->remove(removePtr);
+		return false;
+	}
+};
+}
+
+void TDispatcher::canRemoveWhileDispatching()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	RemovingReceiver first, second;
+	mcr::NoOp sig;
+	first.dispatcherPtr = second.dispatcherPtr = dispatcher.get();
+	dispatcher->add(&sig, &first, 1);
+	dispatcher->add(&sig, &second);
+	dispatcher->add(nullptr, &second);
+
+	/* Removed receivers are skipped by the dispatch removing them */
+	first.removePtr = &second;
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QCOMPARE(first.receivedCount, 1);
+	QCOMPARE(second.receivedCount, 0);
+	QCOMPARE(dispatcher->count(), 1);
+	dispatcher->trim();
+	QCOMPARE(dispatcher->count(), 1);
+
+	/* Receivers may remove themselves, and be added again */
+	first.removePtr = &first;
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QVERIFY(dispatcher->empty());
+	dispatcher->add(&sig, &first);
+	first.removePtr = nullptr;
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QCOMPARE(first.receivedCount, 3);
+	QCOMPARE(dispatcher->count(), 1);
+
+	/* Removing outside of dispatch compacts at once */
+	dispatcher->remove(&first);
+	QVERIFY(dispatcher->empty());
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QCOMPARE(first.receivedCount, 3);
+}
+
+namespace
+{
+/*! Not copyable, dispatched nested at once */
+struct UncopiedSignal final : public mcr::Signal {
+	virtual const char *name() const override
+	{
+		return "UncopiedSignal";
+	}
+	virtual void send() override
+	{
+	}
+};
+
+struct NestingReceiver final : public mcr::IReceive {
+	mcr::Libmacro *contextPtr = nullptr;
+	/*! Nested signals are copies, so identified by NoOp::milliseconds */
+	std::map<int, std::vector<mcr::Signal *>> children;
+	std::vector<mcr::Signal *> received;
+	std::vector<int> receivedIds;
+	/*! Dispatch signals from the stack, destroyed before queued work */
+	bool localFlag = false;
+	/*! Decisions of nested dispatches from the stack */
+	std::vector<bool> nestedBlocked;
+	int depth = 0;
+	int maxDepth = 0;
+
+	virtual bool receive(mcr::Signal *signalPtr, unsigned int) override
+	{
+		if (std::string(signalPtr->name()) == "UncopiedSignal")
+			return true;
+		auto noOpPtr = dynamic_cast<mcr::NoOp *>(signalPtr);
+		const int id = noOpPtr ? noOpPtr->milliseconds : 0;
+		received.push_back(signalPtr);
+		receivedIds.push_back(id);
+		maxDepth = std::max(maxDepth, ++depth);
+		for (auto child : children[id])
+			contextPtr->dispatch(child);
+		if (localFlag && id == 1) {
+			mcr::NoOp local;
+			UncopiedSignal uncopied;
+			local.milliseconds = 4;
+			local.dispatcherPtr = uncopied.dispatcherPtr =
+				signalPtr->dispatcherPtr;
+			local.dispatchFlag = uncopied.dispatchFlag = true;
+			nestedBlocked.push_back(contextPtr->dispatch(&local));
+			nestedBlocked.push_back(
+				contextPtr->dispatch(&uncopied));
+		}
+		--depth;
+		return false;
+	}
+};
+}
+
+void TDispatcher::canDispatchNested()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	NestingReceiver recv;
+	mcr::NoOp a, b, c;
+	int id = 0;
+	for (mcr::NoOp *sigPtr : {&a, &b, &c}) {
+		sigPtr->milliseconds = ++id;
+		sigPtr->dispatcherPtr = dispatcher.get();
+		sigPtr->dispatchFlag = true;
+	}
+	recv.contextPtr = _ctx.get();
+	recv.children[1] = {&b, &c};
+	/* b dispatches a again, a cycle only bounded by depth */
+	recv.children[2] = {&a};
+	dispatcher->add(nullptr, &recv);
+	const unsigned int depthMax = _ctx->dispatchDepthMax();
+	const size_t dropped = _ctx->droppedDispatchCount();
+
+	/* Breadth first, never recursing into dispatch */
+	_ctx->setDispatchDepthMax(3);
+	QVERIFY(!_ctx->dispatch(&a));
+	QCOMPARE(recv.receivedIds, (std::vector<int>{1, 2, 3, 1, 2, 3}));
+	QCOMPARE(recv.maxDepth, 1);
+	QCOMPARE(_ctx->droppedDispatchCount(), dropped + 1);
+
+	/* Depth 0 drops every nested dispatch */
+	recv.receivedIds.clear();
+	_ctx->setDispatchDepthMax(0);
+	QVERIFY(!_ctx->dispatch(&a));
+	QCOMPARE(recv.receivedIds, std::vector<int>{1});
+	QCOMPARE(_ctx->droppedDispatchCount(), dropped + 3);
+
+	/* Queued signals are copied, signals that cannot be copied are
+	 * dispatched at once with their decision. */
+	recv.receivedIds.clear();
+	recv.children.clear();
+	recv.localFlag = true;
+	_ctx->setDispatchDepthMax(1);
+	QVERIFY(!_ctx->dispatch(&a));
+	QCOMPARE(recv.receivedIds, (std::vector<int>{1, 4}));
+	/* Queued returns false, not copied returns blocked */
+	QCOMPARE(recv.nestedBlocked, (std::vector<bool>{false, true}));
+
+	_ctx->setDispatchDepthMax(depthMax);
+	QCOMPARE(_ctx->dispatchDepthMax(), depthMax);
+}
+
+namespace
+{
+struct AcceptingReceiver final : public mcr::IReceive {
+	unsigned int acceptedMods = 0;
+	mutable int acceptsCount = 0;
+	int receivedCount = 0;
+
+	virtual bool receive(mcr::Signal *, unsigned int) override
+	{
+		++receivedCount;
+		return false;
+	}
+	virtual bool accepts(unsigned int mods) const override
+	{
+		++acceptsCount;
+		return mods == acceptedMods;
+	}
+};
+}
+
+void TDispatcher::canCacheDispatch()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	AcceptingReceiver shift, ctrl;
+	shift.acceptedMods = MCR_SHIFT;
+	ctrl.acceptedMods = MCR_CTRL;
+	mcr::Key sig(30);
+	dispatcher->add(&sig, &shift);
+	dispatcher->add(nullptr, &ctrl);
+
+	/* Not cached, every receiver receives */
+	QVERIFY(!dispatcher->cacheFlag());
+	QVERIFY(!dispatcher->dispatch(&sig, 0));
+	QCOMPARE(shift.receivedCount, 1);
+	QCOMPARE(ctrl.receivedCount, 1);
+	QCOMPARE(shift.acceptsCount, 0);
+
+	/* Repeats resolve accepting receivers once */
+	dispatcher->setCacheFlag(true);
+	QVERIFY(dispatcher->cacheFlag());
+	for (int i = 0; i < 3; i++)
+		QVERIFY(!dispatcher->dispatch(&sig, MCR_SHIFT));
+	QCOMPARE(shift.acceptsCount, 1);
+	QCOMPARE(ctrl.acceptsCount, 1);
+	QCOMPARE(shift.receivedCount, 4);
+	QCOMPARE(ctrl.receivedCount, 1);
+	QVERIFY(!dispatcher->dispatch(&sig, MCR_CTRL));
+	QVERIFY(!dispatcher->dispatch(&sig, MCR_CTRL));
+	QCOMPARE(shift.acceptsCount, 2);
+	QCOMPARE(shift.receivedCount, 4);
+	QCOMPARE(ctrl.receivedCount, 3);
+
+	/* Other keys are cached separately */
+	mcr::Key other(31);
+	QVERIFY(!dispatcher->dispatch(&other, MCR_SHIFT));
+	QCOMPARE(shift.receivedCount, 4);
+	QCOMPARE(ctrl.acceptsCount, 3);
+
+	/* Adding and removing resolve again */
+	AcceptingReceiver late;
+	late.acceptedMods = MCR_SHIFT;
+	dispatcher->add(&sig, &late);
+	QVERIFY(!dispatcher->dispatch(&sig, MCR_SHIFT));
+	QCOMPARE(shift.acceptsCount, 3);
+	QCOMPARE(late.receivedCount, 1);
+	dispatcher->remove(&shift);
+	QVERIFY(!dispatcher->dispatch(&sig, MCR_SHIFT));
+	QCOMPARE(shift.receivedCount, 5);
+	QCOMPARE(late.receivedCount, 2);
+	QCOMPARE(late.acceptsCount, 2);
+
+	/* Actions accept by trigger mode */
+	mcr::Action action;
+	action.modifiers = MCR_ALT;
+	QVERIFY(action.accepts(MCR_ALT));
+	QVERIFY(!action.accepts(MCR_ALT | MCR_SHIFT));
+	action.triggerMode = MCR_TM_ALL;
+	QVERIFY(action.accepts(MCR_ALT | MCR_SHIFT));
+}
+
 static mcr_Press_t opp(mcr_Press_t press)
 {
 	return press == MCR_PRESS ? MCR_UNPRESS : MCR_PRESS;
 }
+
+void TDispatcher::canDebounce()
+{
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(_ctx.get());
+	NestingReceiver recv;
+	mcr::Key key(30), other(31);
+	mcr::NoOp noop;
+	for (mcr::Signal *sigPtr : {(mcr::Signal *)&key, (mcr::Signal *)&other,
+				    (mcr::Signal *)&noop}) {
+		sigPtr->dispatcherPtr = dispatcher.get();
+		sigPtr->dispatchFlag = true;
+	}
+	recv.contextPtr = _ctx.get();
+	dispatcher->add(nullptr, &recv);
+	auto press = [](mcr::Key &k, mcr_ApplyValue apply) {
+		k.apply = apply;
+		return _ctx->dispatch(&k);
+	};
+	mcr::Debounce &debounce = _ctx->debounce();
+
+	/* Contexts do not debounce until set */
+	QCOMPARE(debounce.windowMillis(), 0u);
+	QVERIFY(!press(key, MCR_SET));
+	QVERIFY(!press(key, MCR_UNSET));
+	QCOMPARE(recv.received.size(), (size_t)2);
+	recv.received.clear();
+
+	/* Chatter is dropped before the key state and receivers */
+	debounce.setWindowMillis(1000);
+	debounce.clear();
+	const size_t dropped = debounce.droppedCount();
+	QVERIFY(!press(key, MCR_SET));
+	QVERIFY(press(key, MCR_SET));
+	QVERIFY(_ctx->keyState().pressed(key.key));
+	/* Bouncing within the window of the press stays pressed */
+	QVERIFY(press(key, MCR_UNSET));
+	QVERIFY(_ctx->keyState().pressed(key.key));
+	QVERIFY(press(key, MCR_SET));
+	QVERIFY(press(key, MCR_UNSET));
+	QVERIFY(press(key, MCR_SET));
+	QVERIFY(_ctx->keyState().pressed(key.key));
+	/* Other keys and signals pass */
+	QVERIFY(!press(other, MCR_SET));
+	QVERIFY(!_ctx->dispatch(&noop));
+	QCOMPARE(recv.received,
+		 (std::vector<mcr::Signal *>{&key, &other, &noop}));
+	QCOMPARE(debounce.droppedCount(), dropped + 5);
+	recv.received.clear();
+	/* Repeated taps are not chatter */
+	for (int i = 0; i < 3; i++)
+		QVERIFY(!press(other, MCR_BOTH));
+	QCOMPARE(recv.received,
+		 (std::vector<mcr::Signal *>{&other, &other, &other}));
+	QCOMPARE(debounce.droppedCount(), dropped + 5);
+	recv.received.clear();
+	/* Released within the window of its press */
+	QVERIFY(press(other, MCR_UNSET));
+
+	/* Key repeat and transitions after the window pass */
+	debounce.setWindowMillis(1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	QVERIFY(!press(key, MCR_SET));
+	QVERIFY(_ctx->keyState().pressed(key.key));
+	QVERIFY(!press(key, MCR_UNSET));
+	QVERIFY(!_ctx->keyState().pressed(key.key));
+	QCOMPARE(recv.received, (std::vector<mcr::Signal *>{&key, &key}));
+	recv.received.clear();
+	debounce.setWindowMillis(0);
+
+	/* As a receiver, blocks chatter before lower priorities */
+	mcr::Debounce receiverDebounce(1000);
+	dispatcher->add(nullptr, &receiverDebounce, 1);
+	QVERIFY(!press(key, MCR_SET));
+	QVERIFY(press(key, MCR_UNSET));
+	QVERIFY(press(key, MCR_SET));
+	QCOMPARE(recv.received, (std::vector<mcr::Signal *>{&key}));
+	dispatcher->clear();
+	_ctx->keyState().clear();
+}
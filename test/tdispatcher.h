@@ -24,4 +24,20 @@ class TDispatcher : public QObject {
 
 	void canRegister();
 	void canReceive();
+	void canIndexBySignal();
+	void canDispatchWhileModified();
+	void canDispatchInPriorityOrder();
+	void canDispatchBatch();
+	void canDispatchOnQueue();
+	void canDispatchAndSend();
+	void canCountUnreceived();
+	void canDispatchTyped();
+	void canDispatchSharded();
+	void canRecordDispatch();
+	void canQuarantineSlowReceivers();
+	void canModifyByKey();
+	void canRemoveWhileDispatching();
+	void canDispatchNested();
+	void canCacheDispatch();
+	void canDebounce();
 };
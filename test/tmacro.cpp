@@ -5,12 +5,14 @@
 #include "tmacro.h"
 
 #include "mcr/defines.h"
+#include "mcr/dispatcher.h"
 #include "mcr/error.h"
 #include "mcr/factory.h"
 #include "mcr/libmacro.h"
 #include "mcr/macro.h"
 #include "mcr/signal/noop.h"
 
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -156,6 +158,81 @@ void TMacro::canSetActivators()
 	macro->setActivators(nullptr, 0);
 }
 
+namespace
+{
+struct SlowReceiver final : public mcr::IReceive {
+	std::atomic<int> millis{0};
+	std::atomic<int> receivedCount{0};
+
+	virtual bool receive(mcr::Signal *, unsigned int) override
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+		++receivedCount;
+		return false;
+	}
+};
+}
+
+void TMacro::canSetActivatorsWhileQuarantined()
+{
+	auto ctx = mcr::factory::createContext(false);
+	auto *generic = ctx->genericDispatcher();
+	auto dispatcher =
+		mcr::internal::factory::createGenericDispatcher(ctx.get());
+	SlowReceiver genericSlow, slow;
+	mcr::ReceiverStats stats;
+	mcr::NoOp sig;
+	sig.dispatcherPtr = dispatcher.get();
+	for (auto *dispatcherPtr : { generic, dispatcher.get() }) {
+		dispatcherPtr->setStatsFlag(true);
+		dispatcherPtr->setQuarantineMicros(1);
+	}
+	generic->add(&sig, &genericSlow, 1);
+	dispatcher->add(&sig, &slow, 1);
+
+	auto macro = mcr::factory::createMacro(ctx.get());
+	macro->setEnabled(true);
+	macro->setActivators(&sig, 1);
+	generic->add(&sig, macro.get());
+
+	/* Spawning a thread exceeds the budget. */
+	for (int i = 0; i < THREAD_YIELD_MAX; i++) {
+		dispatcher->dispatch(&sig, 0);
+		if (dispatcher->receiverStats(macro.get(), &stats) &&
+		    stats.quarantinedFlag)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	QVERIFY(stats.quarantinedFlag);
+	genericSlow.millis = 1;
+	generic->dispatch(&sig, 0);
+	QVERIFY(generic->receiverStats(&genericSlow, &stats));
+	QVERIFY(stats.quarantinedFlag);
+	QVERIFY(dispatcher->receiverStats(&slow, &stats));
+	QVERIFY(stats.quarantinedFlag);
+
+	/* Removing from the busy generic dispatcher first, the lane starts
+	 * the macro while it is locked. */
+	genericSlow.millis = 100;
+	slow.millis = 20;
+	const int genericCount = genericSlow.receivedCount + 1;
+	const int count = slow.receivedCount + 1;
+	generic->dispatch(&sig, 0);
+	dispatcher->dispatch(&sig, 0);
+	macro->setActivators(&sig, 1);
+
+	for (int i = 0; i < THREAD_YIELD_MAX &&
+			(genericSlow.receivedCount < genericCount ||
+			 slow.receivedCount < count);
+	     i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	QCOMPARE(genericSlow.receivedCount.load(), genericCount);
+	QCOMPARE(slow.receivedCount.load(), count);
+	macro->setActivators(nullptr, 0);
+	macro->setEnabled(false);
+	generic->clear();
+}
+
 void TMacro::canSetSignals()
 {
 	auto macro = mcr::factory::createMacro(_ctx.get());
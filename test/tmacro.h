@@ -26,6 +26,7 @@ class TMacro : public QObject {
 	void canSetEnabled();
 	void canSetContext();
 	void canSetActivators();
+	void canSetActivatorsWhileQuarantined();
 	void canSetSignals();
 	void canSetTriggers();
 	void canClearAll();
@@ -63,11 +63,14 @@ void TSerial::builtinTriggerModes()
 	QCOMPARE(serial.triggerMode("Any"), MCR_TM_ANY);
 	QCOMPARE(serial.triggerMode("User"), MCR_TM_USER);
 	QCOMPARE(serial.triggerMode("Match"), MCR_TM_MATCH);
+	QCOMPARE(serial.triggerMode("EqualOrNone"), MCR_TM_EQUAL_OR_NONE);
+	QCOMPARE(serial.triggerMode("Some"), MCR_TM_SOME);
 
 	QCOMPARE(serial.triggerMode("NonExistent"), (mcr_TriggerMode)-1);
 
 	QCOMPARE(serial.triggerModeName(MCR_TM_EQUAL), "Equal");
 	QCOMPARE(serial.triggerModeName(MCR_TM_MATCH), "Match");
+	QCOMPARE(serial.triggerModeName(MCR_TM_SOME), "Some");
 	QCOMPARE(serial.triggerModeName(MCR_TM_USER), "User");
 }
 